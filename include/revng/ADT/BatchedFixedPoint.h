@@ -0,0 +1,97 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <iterator>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/ThreadPool.h"
+
+#include "revng/ADT/Queue.h"
+#include "revng/Support/Assert.h"
+
+/// Drain \p Queue analyzing several of its items at the same time
+///
+/// Each iteration pops the longest prefix of the queue, up to \p MaxBatchSize
+/// items, whose footprints are pairwise disjoint. The footprint of an item is
+/// the set of keys of the shared state its analysis might read or update.
+/// The members of the batch are then:
+///
+/// 1. prepared by \p Prepare, sequentially and in queue order;
+/// 2. analyzed by \p Analyze, on \p Pool if it's not `nullptr`;
+/// 3. handed all together, in queue order, to \p Commit, which updates the
+///    shared state and might enqueue more items.
+///
+/// Since the shared state is only updated after the whole batch has been
+/// analyzed and no member reads what another one updates, the outcome is the
+/// same as analyzing one item at a time, whatever the number of threads.
+///
+/// \param Footprint `Range(ItemT)`, the returned range needs to stay valid
+///        until the next call.
+/// \param Prepare `PreparedT(ItemT)`.
+/// \param Analyze `ResultT(PreparedT &)`, must not touch the shared state.
+/// \param Commit `void(llvm::ArrayRef<ItemT>, llvm::MutableArrayRef<ResultT>)`.
+template<typename ItemT,
+         typename FootprintT,
+         typename PrepareT,
+         typename AnalyzeT,
+         typename CommitT>
+void runBatchedFixedPoint(UniquedQueue<ItemT> &Queue,
+                          llvm::ThreadPool *Pool,
+                          size_t MaxBatchSize,
+                          FootprintT &&Footprint,
+                          PrepareT &&Prepare,
+                          AnalyzeT &&Analyze,
+                          CommitT &&Commit) {
+  using FootprintRange = std::invoke_result_t<FootprintT &, ItemT>;
+  using KeyIterator = decltype(std::begin(std::declval<FootprintRange &>()));
+  using KeyT = typename std::iterator_traits<KeyIterator>::value_type;
+  using PreparedT = std::invoke_result_t<PrepareT &, ItemT>;
+  using ResultT = std::invoke_result_t<AnalyzeT &, PreparedT &>;
+
+  revng_assert(MaxBatchSize > 0);
+
+  while (not Queue.empty()) {
+    llvm::SmallVector<ItemT, 16> Batch;
+    std::set<KeyT> Touched;
+    while (not Queue.empty() and Batch.size() < MaxBatchSize) {
+      auto &&Keys = Footprint(Queue.head());
+      auto IsTouched = [&Touched](const KeyT &Key) {
+        return Touched.count(Key) != 0;
+      };
+      if (llvm::any_of(Keys, IsTouched))
+        break;
+
+      Touched.insert(std::begin(Keys), std::end(Keys));
+      Batch.push_back(Queue.pop());
+    }
+
+    std::vector<PreparedT> Prepared;
+    Prepared.reserve(Batch.size());
+    for (ItemT &Item : Batch)
+      Prepared.push_back(Prepare(Item));
+
+    std::vector<ResultT> Results(Batch.size());
+    if (Pool != nullptr and Batch.size() > 1) {
+      for (size_t Index = 0; Index < Batch.size(); ++Index) {
+        Pool->async([&Analyze, &Results, &Prepared, Index]() {
+          Results[Index] = Analyze(Prepared[Index]);
+        });
+      }
+      Pool->wait();
+    } else {
+      for (size_t Index = 0; Index < Batch.size(); ++Index)
+        Results[Index] = Analyze(Prepared[Index]);
+    }
+
+    llvm::MutableArrayRef<ResultT> BatchResults(Results);
+    Commit(llvm::ArrayRef<ItemT>(Batch), BatchResults);
+  }
+}
@@ -4,15 +4,21 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <iterator>
+#include <map>
+#include <optional>
 #include <stack>
 #include <vector>
 
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/iterator.h"
+#include "llvm/ADT/iterator_range.h"
 
 #include "revng/ADT/KeyedObjectContainer.h"
 #include "revng/ADT/MutableSet.h"
 #include "revng/ADT/SortedVector.h"
 #include "revng/Support/AccessTracker.h"
+#include "revng/Support/Assert.h"
 #include "revng/Support/Generator.h"
 
 namespace revng {
@@ -28,6 +34,13 @@ namespace revng {
 /// getter that allows to inspect the entire content of the container be
 /// invoked, such as find, begin and end, then the entire container is marked as
 /// accessed.
+///
+/// It can also record which elements have been modified: once write tracking
+/// has been started, the original value of each element is saved the first time
+/// it is accessed through a non-const method. Mutable iterators, such as those
+/// returned by begin and find, save each element the first time they are
+/// dereferenced. Only methods replacing the content in bulk, such as clear,
+/// save the entire container.
 template<KeyedObjectContainer T>
 class TrackingContainer {
 public:
@@ -43,11 +56,51 @@ public:
   using const_reference = typename T::const_reference;
   using pointer = typename T::pointer;
   using const_pointer = typename T::const_pointer;
-  using iterator = typename T::iterator;
   using const_iterator = typename T::const_iterator;
-  using reverse_iterator = typename T::reverse_iterator;
   using const_reverse_iterator = typename T::const_reverse_iterator;
 
+  /// Mutable iterator recording as written each element it dereferences
+  template<typename BaseIterator>
+  class RecordingIterator
+    : public llvm::iterator_adaptor_base<
+        RecordingIterator<BaseIterator>,
+        BaseIterator,
+        typename std::iterator_traits<BaseIterator>::iterator_category,
+        value_type,
+        difference_type,
+        value_type *,
+        value_type &> {
+  private:
+    using Base = llvm::iterator_adaptor_base<
+      RecordingIterator<BaseIterator>,
+      BaseIterator,
+      typename std::iterator_traits<BaseIterator>::iterator_category,
+      value_type,
+      difference_type,
+      value_type *,
+      value_type &>;
+
+  private:
+    const TrackingContainer *Owner = nullptr;
+
+  public:
+    RecordingIterator() = default;
+    RecordingIterator(BaseIterator It, const TrackingContainer *Owner) :
+      Base(It), Owner(Owner) {}
+
+  public:
+    value_type &operator*() const {
+      value_type &Element = *this->wrapped();
+      Owner->recordWrite(KeyedObjectTraits<value_type>::key(Element));
+      return Element;
+    }
+
+    BaseIterator unwrap() const { return this->wrapped(); }
+  };
+
+  using iterator = RecordingIterator<typename T::iterator>;
+  using reverse_iterator = RecordingIterator<typename T::reverse_iterator>;
+
   struct TrackingResult {
     bool Exact;
     TrackingSet InspectedKeys;
@@ -64,11 +117,69 @@ private:
 
   mutable bool TrackingIsActive = false;
 
+  /// Content of the container before a write tracking session started
+  struct WriteLog {
+    /// The original value of each of the elements that might have been
+    /// modified, std::nullopt if the element did not exist
+    std::map<std::remove_const_t<key_type>, std::optional<value_type>> Elements;
+
+    /// The original content of the entire container, if the container might
+    /// have been modified in ways that cannot be tracked by key. When set,
+    /// Elements is empty.
+    std::optional<T> WholeContent;
+
+    void recordElement(const T &Content, const key_type &Key) {
+      if (WholeContent.has_value())
+        return;
+
+      auto [It, Inserted] = Elements.try_emplace(Key);
+      if (not Inserted)
+        return;
+
+      auto Iter = Content.find(Key);
+      if (Iter != Content.end())
+        It->second = *Iter;
+    }
+
+    void recordInsertion(const key_type &Key) {
+      if (not WholeContent.has_value())
+        Elements.try_emplace(Key);
+    }
+
+    void recordWhole(const T &Content) {
+      if (WholeContent.has_value())
+        return;
+
+      // Undo the changes to the elements we have already recorded
+      WholeContent = Content;
+      for (auto &[Key, Original] : Elements) {
+        if (Original.has_value())
+          WholeContent->insert_or_assign(std::move(*Original));
+        else
+          WholeContent->erase(Key);
+      }
+      Elements.clear();
+    }
+  };
+
+  /// Stack of write tracking sessions, innermost last. It is never propagated
+  /// by copies or moves.
+  struct WriteLogStack {
+    std::vector<WriteLog> Logs;
+
+    WriteLogStack() = default;
+    WriteLogStack(const WriteLogStack &) {}
+    WriteLogStack &operator=(const WriteLogStack &) { return *this; }
+  };
+
+  mutable WriteLogStack Writes;
+
 public:
   /// \defgroup Methods related to tracking
   /// @{
 
   void stopTracking() const { TrackingIsActive = false; }
+  void markExact() const { Exact.access(); }
   void clearTracking() const {
     Exact.clear();
     NonExisting = {};
@@ -111,6 +222,17 @@ public:
     Exact.pop();
   }
 
+  void startWriteTracking() const { Writes.Logs.emplace_back(); }
+
+  /// \note the caller is responsible for inspecting the returned log to compute
+  ///       the actual changes
+  WriteLog stopWriteTracking() const {
+    revng_assert(not Writes.Logs.empty());
+    WriteLog Result = std::move(Writes.Logs.back());
+    Writes.Logs.pop_back();
+    return Result;
+  }
+
   /// @}
 
 public:
@@ -122,64 +244,133 @@ public:
 
   TrackingContainer(std::initializer_list<T> List) : T(std::move(List)) {}
 
-  TrackingContainer(TrackingContainer &&) = default;
+  TrackingContainer(TrackingContainer &&Other) noexcept {
+    *this = std::move(Other);
+  }
   TrackingContainer(const TrackingContainer &) = default;
   ~TrackingContainer() = default;
-  TrackingContainer &operator=(TrackingContainer &&) = default;
-  TrackingContainer &operator=(const TrackingContainer &) = default;
+
+  TrackingContainer &operator=(TrackingContainer &&Other) noexcept {
+    if (this == &Other)
+      return *this;
+
+    recordWholeWrite();
+    Other.recordWholeWrite();
+    Content = std::move(Other.Content);
+    Exact = Other.Exact;
+    NonExisting = std::move(Other.NonExisting);
+    Existing = std::move(Other.Existing);
+    TrackingIsActive = Other.TrackingIsActive;
+    return *this;
+  }
+
+  TrackingContainer &operator=(const TrackingContainer &Other) {
+    if (this == &Other)
+      return *this;
+
+    recordWholeWrite();
+    Content = Other.Content;
+    Exact = Other.Exact;
+    NonExisting = Other.NonExisting;
+    Existing = Other.Existing;
+    TrackingIsActive = Other.TrackingIsActive;
+    return *this;
+  }
+
   TrackingContainer &operator=(const T &Other) {
+    recordWholeWrite();
     Content = Other;
     return *this;
   }
   TrackingContainer &operator=(T &&Other) {
+    recordWholeWrite();
     Content = std::move(Other);
     return *this;
   }
 
-  void swap(TrackingContainer &Other) { Content.swap(Other.Content); }
+  void swap(TrackingContainer &Other) {
+    recordWholeWrite();
+    Other.recordWholeWrite();
+    Content.swap(Other.Content);
+  }
 
-  value_type &at(const key_type &Key) { return Content.at(Key); }
+  value_type &at(const key_type &Key) {
+    recordWrite(Key);
+    return Content.at(Key);
+  }
 
-  value_type &operator[](key_type &&Key) { return Content[Key]; }
+  value_type &operator[](key_type &&Key) {
+    recordWrite(Key);
+    return Content[Key];
+  }
 
-  iterator begin() { return Content.begin(); }
+  iterator begin() { return iterator(Content.begin(), this); }
 
-  iterator end() { return Content.end(); }
+  iterator end() { return iterator(Content.end(), this); }
 
-  reverse_iterator rbegin() { return Content.rbegin(); }
+  reverse_iterator rbegin() { return reverse_iterator(Content.rbegin(), this); }
 
-  reverse_iterator rend() { return Content.rend(); }
+  reverse_iterator rend() { return reverse_iterator(Content.rend(), this); }
 
-  void clear() { Content.clear(); }
+  void clear() {
+    recordWholeWrite();
+    Content.clear();
+  }
 
   void reserve(size_type NewSize) { Content.reserve(NewSize); }
 
   std::pair<iterator, bool> insert(const value_type &Value) {
-    return Content.insert(Value);
+    recordWrite(KeyedObjectTraits<value_type>::key(Value));
+    return wrap(Content.insert(Value));
   }
 
   template<typename... Types>
   std::pair<iterator, bool> emplace(Types &&...Values) {
-    return Content.emplace(std::forward<Types>(Values)...);
+    auto Result = Content.emplace(std::forward<Types>(Values)...);
+    if (not Writes.Logs.empty()) {
+      auto Key = KeyedObjectTraits<value_type>::key(*Result.first);
+      if (Result.second)
+        recordInsertion(Key);
+      else
+        recordWrite(Key);
+    }
+    return wrap(std::move(Result));
   }
 
   std::pair<iterator, bool> insert_or_assign(const value_type &Value) {
-    return Content.insert_or_assign(Value);
+    recordWrite(KeyedObjectTraits<value_type>::key(Value));
+    return wrap(Content.insert_or_assign(Value));
   }
 
-  iterator erase(iterator Pos) { return Content.erase(Pos); }
+  iterator erase(iterator Pos) {
+    recordWrite(KeyedObjectTraits<value_type>::key(*Pos.unwrap()));
+    return iterator(Content.erase(Pos.unwrap()), this);
+  }
 
   iterator erase(iterator First, iterator Last) {
-    return Content.erase(First, Last);
+    auto Range = llvm::make_range(First.unwrap(), Last.unwrap());
+    if (not Writes.Logs.empty())
+      for (const value_type &Element : Range)
+        recordWrite(KeyedObjectTraits<value_type>::key(Element));
+    return iterator(Content.erase(First.unwrap(), Last.unwrap()), this);
   }
 
-  size_type erase(const key_type &Key) { return Content.erase(Key); }
+  size_type erase(const key_type &Key) {
+    recordWrite(Key);
+    return Content.erase(Key);
+  }
 
-  iterator find(const key_type &Key) { return Content.find(Key); }
+  iterator find(const key_type &Key) {
+    return iterator(Content.find(Key), this);
+  }
 
-  iterator lower_bound(const key_type &Key) { return Content.lower_bound(Key); }
+  iterator lower_bound(const key_type &Key) {
+    return iterator(Content.lower_bound(Key), this);
+  }
 
-  iterator upper_bound(const key_type &Key) { return Content.upper_bound(Key); }
+  iterator upper_bound(const key_type &Key) {
+    return iterator(Content.upper_bound(Key), this);
+  }
   /// @}
 
 public:
@@ -196,7 +387,10 @@ public:
     return Content.at(Key);
   }
 
-  value_type &operator[](const key_type &Key) { return Content[Key]; }
+  value_type &operator[](const key_type &Key) {
+    recordWrite(Key);
+    return Content[Key];
+  }
 
   const_iterator begin() const {
     Exact.access();
@@ -300,11 +494,15 @@ public:
 public:
   using BatchInserter = typename T::BatchInserter;
 
-  BatchInserter batch_insert() { return BatchInserter(Content); }
+  BatchInserter batch_insert() {
+    recordWholeWrite();
+    return BatchInserter(Content);
+  }
 
   using BatchInsertOrAssigner = typename T::BatchInsertOrAssigner;
 
   BatchInsertOrAssigner batch_insert_or_assign() {
+    recordWholeWrite();
     return Content.batch_insert_or_assign();
   }
 
@@ -332,6 +530,26 @@ public:
   }
 
 private:
+  std::pair<iterator, bool>
+  wrap(std::pair<typename T::iterator, bool> &&Result) {
+    return { iterator(Result.first, this), Result.second };
+  }
+
+  void recordWrite(const key_type &Key) const {
+    for (WriteLog &Log : Writes.Logs)
+      Log.recordElement(Content, Key);
+  }
+
+  void recordInsertion(const key_type &Key) const {
+    for (WriteLog &Log : Writes.Logs)
+      Log.recordInsertion(Key);
+  }
+
+  void recordWholeWrite() const {
+    for (WriteLog &Log : Writes.Logs)
+      Log.recordWhole(Content);
+  }
+
   void markExistingKey(const key_type &Key) const {
     if (not TrackingIsActive)
       return;
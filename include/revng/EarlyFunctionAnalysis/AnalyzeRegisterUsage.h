@@ -18,6 +18,8 @@
 
 namespace efa {
 
+extern Logger<> RUALog;
+
 // TODO: switch to model::Register?
 using CSVSet = std::set<llvm::GlobalVariable *>;
 
@@ -71,6 +73,10 @@ public:
 extern template void RUAResults::dump<Logger<true>>(Logger<true> &,
                                                     const char *) const;
 
+/// Run the register usage analyses on \p F
+///
+/// This only reads the IR of \p F, therefore it can run concurrently on
+/// distinct functions as long as nobody is modifying the module.
 RUAResults analyzeRegisterUsage(llvm::Function *F,
                                 const GeneratedCodeBasicInfo &,
                                 model::Architecture::Values Architecture,
@@ -9,7 +9,11 @@
 #include <map>
 #include <queue>
 #include <type_traits>
+#include <vector>
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallSet.h"
@@ -19,6 +23,7 @@
 #include "revng/ADT/Concepts.h"
 #include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/ReversePostOrderTraversal.h"
+#include "revng/Support/Assert.h"
 
 namespace MFP {
 
@@ -63,6 +68,9 @@ using MFIResultMap = ResultMap<typename MFI::Label,
 /// graph. This is needed for the RPOT because for certain graph (e.g.
 /// Inverse<...>) the nodes don't necessary carry all the information that
 /// GraphType has.
+///
+/// Internally, nodes are numbered once and the values are kept in a vector
+/// indexed by such number: the result map is only built at the end.
 template<MonotoneFrameworkInstance MFI,
          typename GT = llvm::GraphTraits<typename MFI::GraphType>,
          typename LGT = typename MFI::Label>
@@ -75,63 +83,90 @@ getMaximalFixedPoint(const MFI &Instance,
                      const std::vector<typename MFI::Label> &InitialNodes) {
   using Label = typename MFI::Label;
   using LatticeElement = typename MFI::LatticeElement;
+  using VisitedSet = llvm::DenseSet<Label>;
 
-  std::map<Label, LatticeElement> PartialAnalysis;
-  std::map<Label, MFPResult<LatticeElement>> AnalysisResult;
+  //
+  // Number the nodes
+  //
 
-  struct WorklistItem {
-    size_t Priority;
-    Label Item;
+  // Nodes are numbered in reverse post order, launching a visit from each
+  // initial node not visited yet. The number of a node is also its priority in
+  // the worklist.
+  std::vector<Label> Nodes;
+  llvm::DenseMap<Label, size_t> NodeIndex;
+  VisitedSet Visited;
+  for (Label Start : InitialNodes) {
+    if (Visited.contains(Start))
+      continue;
 
-    std::strong_ordering operator<=>(const WorklistItem &) const = default;
-  };
-  std::set<WorklistItem> Worklist;
+    ReversePostOrderTraversalExt<LGT, GT, VisitedSet> RPOTE(Start, Visited);
+    for (Label Node : RPOTE) {
+      NodeIndex[Node] = Nodes.size();
+      Nodes.push_back(Node);
+    }
+  }
 
-  llvm::SmallSet<Label, 8> Visited{};
-  std::map<Label, size_t> LabelPriority;
+  // Extremal labels that have not been visited are part of the results, but
+  // never enter the worklist
+  size_t VisitedCount = Nodes.size();
+  for (Label ExtremalLabel : ExtremalLabels) {
+    if (NodeIndex.try_emplace(ExtremalLabel, Nodes.size()).second)
+      Nodes.push_back(ExtremalLabel);
+  }
 
   //
-  // Initialize the worklist and extremal labels
+  // Initialize the values and the worklist
   //
-  for (Label ExtremalLabel : ExtremalLabels) {
-    AnalysisResult[ExtremalLabel].InValue = ExtremalValue;
-  }
+  std::vector<MFPResult<LatticeElement>> Values(Nodes.size());
+  for (size_t Index = 0; Index < VisitedCount; ++Index)
+    Values[Index].InValue = InitialValue;
 
-  for (Label Start : InitialNodes) {
-    if (!Visited.contains(Start)) {
-      // Fill the worklist with nodes in reverse post order launching a visit
-      // from each remaining node
-      ReversePostOrderTraversalExt<LGT, GT, llvm::SmallSet<Label, 8>>
-        RPOTE(Start, Visited);
-      for (Label Node : RPOTE) {
-        LabelPriority[Node] = LabelPriority.size();
-        Worklist.insert({ LabelPriority.at(Node), Node });
-        // initialize the analysis value for non extremal nodes
-        if (!AnalysisResult.contains(Node))
-          AnalysisResult[Node].InValue = InitialValue;
-      }
-    }
-  }
+  for (Label ExtremalLabel : ExtremalLabels)
+    Values[NodeIndex.find(ExtremalLabel)->second].InValue = ExtremalValue;
 
-  // Step 2 iteration
-  while (!Worklist.empty()) {
-    WorklistItem First = *Worklist.begin();
-    Label Start = First.Item;
-    Worklist.erase(First);
-    auto &LabelAnalysis = AnalysisResult.at(Start);
+  // Pending nodes are set bits, the lowest one has the highest priority
+  llvm::BitVector Worklist(VisitedCount, true);
+  int Next = Worklist.find_first();
+
+  //
+  // Iterate until the fixed point is reached
+  //
+  while (Next != -1) {
+    size_t StartIndex = Next;
+    Worklist.reset(StartIndex);
+    Label Start = Nodes[StartIndex];
+
+    auto &LabelAnalysis = Values[StartIndex];
     LabelAnalysis
       .OutValue = Instance.applyTransferFunction(Start, LabelAnalysis.InValue);
 
+    // Nodes already processed might be enqueued again
+    int Lowest = -1;
     for (Label End : successors<GT>(Start)) {
-      auto &PartialEnd = AnalysisResult.at(End);
+      auto It = NodeIndex.find(End);
+      revng_assert(It != NodeIndex.end());
+      size_t EndIndex = It->second;
+      auto &PartialEnd = Values[EndIndex];
       if (!Instance.isLessOrEqual(LabelAnalysis.OutValue, PartialEnd.InValue)) {
         PartialEnd.InValue = Instance.combineValues(PartialEnd.InValue,
                                                     LabelAnalysis.OutValue);
-        Worklist.insert({ LabelPriority.at(End), End });
+        revng_assert(EndIndex < VisitedCount);
+        Worklist.set(EndIndex);
+        if (Lowest == -1 or EndIndex < static_cast<size_t>(Lowest))
+          Lowest = static_cast<int>(EndIndex);
       }
     }
+
+    if (Lowest != -1 and static_cast<size_t>(Lowest) <= StartIndex)
+      Next = Lowest;
+    else
+      Next = Worklist.find_next(StartIndex);
   }
 
+  MFIResultMap<MFI> AnalysisResult;
+  for (size_t Index = 0; Index < Nodes.size(); ++Index)
+    AnalysisResult.emplace(Nodes[Index], std::move(Values[Index]));
+
   return AnalysisResult;
 }
 
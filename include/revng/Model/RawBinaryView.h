@@ -4,31 +4,101 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <cstdint>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 
 #include "revng/Model/Binary.h"
 #include "revng/Support/Generator.h"
 #include "revng/Support/OverflowSafeInt.h"
 
+/// Index of a set of possibly overlapping ranges, one per segment, over either
+/// the address space or the file.
+///
+/// The indexed space is split in elementary intervals, in which the set of
+/// segments covering each point is the same. Looking up the segments covering
+/// a point is then a binary search over the boundaries of such intervals.
+class SegmentIntervalIndex {
+public:
+  struct Range {
+    uint64_t Start = 0;
+    uint64_t End = 0;
+    const model::Segment *Segment = nullptr;
+  };
+
+private:
+  /// Sorted boundaries of the elementary intervals: the I-th interval starts at
+  /// Boundaries[I] and ends at Boundaries[I + 1]
+  std::vector<uint64_t> Boundaries;
+
+  /// The segments covering the I-th interval are in Covering, between
+  /// FirstCovering[I] and FirstCovering[I + 1]
+  std::vector<uint32_t> FirstCovering;
+  std::vector<const model::Segment *> Covering;
+
+public:
+  SegmentIntervalIndex() = default;
+  explicit SegmentIntervalIndex(llvm::ArrayRef<Range> Ranges);
+
+public:
+  /// \return the segments covering \p Value, in the order in which they have
+  ///         been provided at construction time.
+  llvm::ArrayRef<const model::Segment *> lookup(uint64_t Value) const {
+    if (Boundaries.empty() or Value < Boundaries.front()
+        or Value >= Boundaries.back())
+      return {};
+
+    auto It = std::upper_bound(Boundaries.begin(), Boundaries.end(), Value);
+    size_t Index = std::distance(Boundaries.begin(), It) - 1;
+    uint32_t First = FirstCovering[Index];
+    return llvm::makeArrayRef(Covering).slice(First,
+                                              FirstCovering[Index + 1] - First);
+  }
+};
+
 /// Provide a view onto a raw binary through the lens of the model
 class RawBinaryView {
 private:
   using OverflowSafeInt = OverflowSafeInt<uint64_t>;
+  using SegmentsVector = llvm::SmallVector<const model::Segment *, 2>;
 
 private:
   const model::Binary &Binary;
   llvm::ArrayRef<uint8_t> Data;
 
+  /// \name Segment lookup acceleration
+  ///
+  /// The indexes are built at construction time and by reindex, which must be
+  /// invoked after the segments of the model have been changed. As a safety
+  /// net, lookups fall back to a linear scan if the set of segments has
+  /// evidently changed, and the candidates found through the indexes are
+  /// always checked against the current range of the segment.
+  ///
+  /// @{
+  SegmentIntervalIndex AddressIndex;
+  SegmentIntervalIndex OffsetIndex;
+  const model::Segment *IndexedSegments = nullptr;
+  size_t IndexedSegmentsCount = 0;
+  /// @}
+
 public:
   RawBinaryView(const model::Binary &Binary, llvm::StringRef Data) :
     RawBinaryView(Binary, { Data.bytes_begin(), Data.bytes_end() }) {}
 
   RawBinaryView(const model::Binary &Binary, llvm::ArrayRef<uint8_t> Data) :
-    Binary(Binary), Data(Data) {}
+    Binary(Binary), Data(Data) {
+    buildIndexes();
+  }
+
+public:
+  /// Rebuild the segment lookup indexes, to be invoked after adding, removing
+  /// or altering the segments of the model.
+  void reindex() { buildIndexes(); }
 
 public:
   uint64_t size() { return Data.size(); }
@@ -132,17 +202,10 @@ public:
     using namespace model;
 
     const Segment *Match = nullptr;
-    for (const Segment &Segment : Binary.Segments()) {
-      if (Segment.StartOffset() <= Offset and Offset < Segment.endOffset()) {
-        if (Match != nullptr) {
-          // We have more than one match!
-          Match = nullptr;
-          break;
-        }
-
-        Match = &Segment;
-      }
-    }
+    SegmentsVector Candidates = segmentsAtOffset(Offset);
+    // We want one and only one match
+    if (Candidates.size() == 1)
+      Match = Candidates[0];
 
     if (Match != nullptr) {
       auto OffsetInSegment = OverflowSafeInt(Offset) - Match->StartOffset();
@@ -155,9 +218,9 @@ public:
   }
 
   [[nodiscard]] bool isReadOnly(MetaAddress Address, uint64_t Size) const {
-    for (const model::Segment &Segment : Binary.Segments()) {
-      if (Segment.contains(Address, Size)) {
-        if (!Segment.IsWriteable()) {
+    for (const model::Segment *Segment : segmentsAt(Address)) {
+      if (Segment->contains(Address, Size)) {
+        if (!Segment->IsWriteable()) {
           return true;
         }
       }
@@ -180,8 +243,8 @@ private:
   std::pair<const model::Segment *, uint64_t>
   findOffsetInSegment(MetaAddress Address, uint64_t Size) const {
     const model::Segment *Match = nullptr;
-    for (const model::Segment &Segment : Binary.Segments()) {
-      if (Segment.contains(Address, Size)) {
+    for (const model::Segment *Segment : segmentsAt(Address)) {
+      if (Segment->contains(Address, Size)) {
 
         if (Match != nullptr) {
           // We have more than one match!
@@ -189,7 +252,7 @@ private:
           break;
         }
 
-        Match = &Segment;
+        Match = Segment;
       }
     }
 
@@ -202,4 +265,20 @@ private:
 
     return { nullptr, 0 };
   }
+
+  void buildIndexes();
+
+  bool areIndexesUpToDate() const {
+    const auto &Segments = Binary.Segments();
+    const model::Segment *First = nullptr;
+    if (not Segments.empty())
+      First = &*Segments.begin();
+    return First == IndexedSegments and Segments.size() == IndexedSegmentsCount;
+  }
+
+  /// \return the segments whose virtual address range contains \p Address.
+  SegmentsVector segmentsAt(MetaAddress Address) const;
+
+  /// \return the segments whose file range contains \p Offset.
+  SegmentsVector segmentsAtOffset(uint64_t Offset) const;
 };
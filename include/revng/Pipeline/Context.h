@@ -41,6 +41,10 @@ private:
   llvm::StringMap<std::any> Contexts;
   KindsRegistry TheKindRegistry;
 
+  // Interning targets does not alter the observable state of the context, it
+  // is therefore allowed on a const Context
+  mutable TargetsInterner Interner;
+
   llvm::StringMap<const pipeline::ContainerSet::value_type *>
     ReadOnlyContainers;
 
@@ -99,6 +103,8 @@ public:
     return Casted;
   }
 
+  TargetsInterner &getTargetsInterner() const { return Interner; }
+
   const GlobalsMap &getGlobals() const { return Globals; }
   GlobalsMap &getGlobals() { return Globals; }
 
@@ -131,12 +137,13 @@ public:
 public:
   void collectReadFields(const TargetInContainer &Target,
                          llvm::StringMap<PathTargetBimap> &Out) const {
-    Globals.collectReadFields(Target, Out);
+    Globals.collectReadFields(Interner.intern(Target), Out);
   }
 
   void clearAndResume() const { Globals.clearAndResume(); }
   void pushReadFields() const { Globals.pushReadFields(); }
   void popReadFields() const { Globals.popReadFields(); }
   void stopTracking() const { Globals.stopTracking(); }
+  void markAllRead() const { Globals.markAllRead(); }
 };
 } // namespace pipeline
@@ -11,6 +11,7 @@
 #include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/PassRegistry.h"
 
@@ -33,6 +34,7 @@ public:
   virtual std::unique_ptr<LLVMPassWrapperBase> clone() const = 0;
   virtual llvm::StringRef getName() const = 0;
   virtual void print(llvm::raw_ostream &OS) const = 0;
+  virtual bool isFunctionLocal() const = 0;
 };
 
 template<typename T>
@@ -41,6 +43,18 @@ concept LLVMPass = requires(T P) {
   { P.registerPasses(std::declval<llvm::legacy::PassManager &>()) };
 };
 
+/// A function local pass only transforms each target on the basis of the target
+/// itself, hence it can be run concurrently on disjoint subsets of the targets
+/// in a module, each cloned in its own llvm::LLVMContext.
+///
+/// Function local passes must not modify the model. Since model reads cannot be
+/// tracked while running concurrently, a pipe running on shards is considered
+/// to have read the whole model.
+template<typename T>
+concept LLVMFunctionLocalPass = LLVMPass<T> and requires {
+  requires T::IsFunctionLocal;
+};
+
 template<typename T>
 concept LLVMPrintablePass = requires(T P) {
   { P.print(llvm::outs()) };
@@ -80,6 +94,8 @@ public:
   std::unique_ptr<LLVMPassWrapperBase> clone() const override;
 
   llvm::StringRef getName() const override { return PassName; }
+
+  bool isFunctionLocal() const override { return false; }
 };
 
 /// LLVM pipes are pipes composed of any number of llvm passes
@@ -131,10 +147,16 @@ public:
     else
       OS << "-" << T::Name;
   }
+
+  bool isFunctionLocal() const override { return LLVMFunctionLocalPass<T>; }
 };
 
 /// Implementation of the LLVM pipes to be instantiated for a particular LLVM
 /// container
+///
+/// If all the passes are function local and `-llvm-pipe-threads` is not 1, the
+/// targets of the container are split in shards which are processed
+/// concurrently and then linked back together.
 class GenericLLVMPipe {
 private:
   llvm::SmallVector<std::unique_ptr<LLVMPassWrapperBase>, 4> Passes;
@@ -178,6 +200,13 @@ public:
 
   void run(const ExecutionContext &, LLVMContainer &Container);
 
+  bool isFunctionLocal() const {
+    const auto IsFunctionLocal = [](const auto &Pass) {
+      return Pass->isFunctionLocal();
+    };
+    return not Passes.empty() and llvm::all_of(Passes, IsFunctionLocal);
+  }
+
   void addPass(const PureLLVMPassWrapper &Pass) {
     Passes.emplace_back(Pass.clone());
   }
@@ -223,6 +252,13 @@ public:
   }
 
   void dump() const debug_function { dump(dbg); }
+
+private:
+  void registerPasses(llvm::legacy::PassManager &Manager);
+
+  void runSharded(const ExecutionContext &Ctx,
+                  LLVMContainer &Container,
+                  unsigned ThreadsCount);
 };
 
 class O2Pipe {
@@ -4,8 +4,11 @@
 //
 
 #include <any>
+#include <cstdint>
 #include <memory>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Error.h"
@@ -18,6 +21,7 @@
 #include "revng/Support/YAMLTraits.h"
 #include "revng/TupleTree/Tracking.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
+#include "revng/TupleTree/TupleTreeHash.h"
 
 namespace pipeline {
 
@@ -65,12 +69,25 @@ public:
   virtual std::optional<std::string>
   serializePath(const TupleTreePath &Path) const = 0;
 
-  virtual void collectReadFields(const TargetInContainer &Target,
+  /// \return a hash of the content of \p Path that changes whenever a diff
+  ///         would report a change on \p Path, std::nullopt if the path does
+  ///         not exist
+  virtual std::optional<uint64_t> hashPath(const TupleTreePath &Path) const = 0;
+
+  virtual void collectReadFields(TargetsInterner::ID Target,
                                  PathTargetBimap &Out) = 0;
   virtual void clearAndResume() const = 0;
   virtual void pushReadFields() const = 0;
   virtual void popReadFields() const = 0;
   virtual void stopTracking() const = 0;
+  virtual void markAllRead() const = 0;
+
+  /// Start recording the modifications of this global, so that they can later
+  /// be obtained through collectWrites without copying it upfront.
+  ///
+  /// Sessions can be nested, and must be terminated in reverse order.
+  virtual void startWriteTracking() = 0;
+  virtual GlobalTupleTreeDiff collectWrites() = 0;
 };
 
 template<TupleTreeCompatibleAndVerifiable Object>
@@ -78,6 +95,10 @@ class TupleTreeGlobal : public Global {
 private:
   TupleTree<Object> Value;
 
+  /// One entry for each active write tracking session, holding the top-level
+  /// fields of Value that are not containers at the time the session started
+  std::vector<std::pair<const Object *, Object>> WriteBaselines;
+
   static const char &getID() {
     static char ID;
     return ID;
@@ -88,7 +109,8 @@ public:
     Global(&getID(), Name), Value(std::move(Value)) {}
 
   explicit TupleTreeGlobal(llvm::StringRef Name) : Global(&getID(), Name) {}
-  TupleTreeGlobal(const TupleTreeGlobal &Other) = default;
+  TupleTreeGlobal(const TupleTreeGlobal &Other) :
+    Global(Other), Value(Other.Value) {}
   TupleTreeGlobal(TupleTreeGlobal &&Other) = default;
   TupleTreeGlobal &operator=(const TupleTreeGlobal &Other) = default;
   TupleTreeGlobal &operator=(TupleTreeGlobal &&Other) = default;
@@ -187,7 +209,12 @@ public:
     return pathAsString<Object>(Path);
   }
 
-  void collectReadFields(const TargetInContainer &Target,
+  std::optional<uint64_t> hashPath(const TupleTreePath &Path) const override {
+    const TupleTree<Object> &AsConst = Value;
+    return hashByPath(*AsConst, Path);
+  }
+
+  void collectReadFields(TargetsInterner::ID Target,
                          PathTargetBimap &Out) override {
     const TupleTree<Object> &AsConst = Value;
     ReadFields Results = revng::Tracking::collect(*AsConst);
@@ -203,6 +230,30 @@ public:
   void pushReadFields() const override { revng::Tracking::push(*Value); }
   void popReadFields() const override { revng::Tracking::pop(*Value); }
   void stopTracking() const override { revng::Tracking::stop(*Value); }
+  void markAllRead() const override { revng::Tracking::markAllRead(*Value); }
+
+  void startWriteTracking() override {
+    const TupleTree<Object> &AsConst = Value;
+    const Object &Root = *AsConst;
+    WriteBaselines.emplace_back(&Root, Object());
+    ::startWriteTracking(Root, WriteBaselines.back().second);
+  }
+
+  GlobalTupleTreeDiff collectWrites() override {
+    revng_assert(not WriteBaselines.empty());
+    auto [TrackedRoot, Baseline] = std::move(WriteBaselines.back());
+    WriteBaselines.pop_back();
+
+    // Modifications are recorded by the root object, hence it must not be
+    // replaced, for instance by moving another TupleTree into Value
+    const TupleTree<Object> &AsConst = Value;
+    const Object &Root = *AsConst;
+    revng_assert(TrackedRoot == &Root,
+                 "The global has been replaced while tracking writes");
+
+    auto Diff = ::diffWrites(Root, Baseline);
+    return GlobalTupleTreeDiff(std::move(Diff), getName());
+  }
 };
 
 } // namespace pipeline
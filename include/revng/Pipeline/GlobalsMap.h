@@ -153,7 +153,7 @@ public:
 
     return *this;
   }
-  void collectReadFields(const TargetInContainer &Target,
+  void collectReadFields(TargetsInterner::ID Target,
                          llvm::StringMap<PathTargetBimap> &Out) const {
     for (const auto &Global : Map) {
       Global.second->collectReadFields(Target, Out[Global.first]);
@@ -176,5 +176,23 @@ public:
     for (const auto &Global : Map)
       Global.second->stopTracking();
   }
+  void markAllRead() const {
+    for (const auto &Global : Map)
+      Global.second->markAllRead();
+  }
+
+  void startWriteTracking() {
+    for (const auto &Global : Map)
+      Global.second->startWriteTracking();
+  }
+
+  /// \return the changes performed on each global since the matching call to
+  ///         startWriteTracking, equivalent to the result of diff
+  DiffMap collectWrites() {
+    DiffMap ToReturn;
+    for (const auto &Global : Map)
+      ToReturn.try_emplace(Global.first, Global.second->collectWrites());
+    return ToReturn;
+  }
 };
 } // namespace pipeline
@@ -0,0 +1,204 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Global.h"
+#include "revng/Pipeline/PathTargetBimap.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/TupleTree/TupleTreePath.h"
+
+namespace pipeline {
+
+class TargetInPipe {
+public:
+  std::string SerializedTarget;
+  std::string PipeName;
+
+  llvm::Expected<llvm::SmallVector<TargetInContainer, 2>>
+  deserialize(const Context &Ctx, llvm::StringRef ContainerName) const;
+
+  static TargetInPipe fromTargetInContainer(const TargetInContainer &Target,
+                                            llvm::StringRef PipeName);
+  bool operator<(const TargetInPipe &Other) const {
+    const auto &Tied = std::tie(SerializedTarget, PipeName);
+    return Tied < std::tie(Other.SerializedTarget, Other.PipeName);
+  }
+};
+
+/// Memoizes the parsing and the hashing of the strings of the invalidation
+/// metadata of a container, since the same targets and paths are repeated
+/// across many pipes and entries
+class InvalidationMetadataCache {
+public:
+  struct ParsedPath {
+    TupleTreePath Path;
+    bool Hashed = false;
+    std::optional<uint64_t> Hash;
+  };
+
+private:
+  llvm::StringMap<llvm::SmallVector<TargetInContainer, 2>> Targets;
+
+  /// Parsed paths, indexed by global name and serialized path
+  llvm::StringMap<llvm::StringMap<ParsedPath>> Paths;
+
+public:
+  llvm::Expected<const llvm::SmallVector<TargetInContainer, 2> *>
+  getTargets(const Context &Ctx,
+             const TargetInPipe &Target,
+             llvm::StringRef ContainerName);
+
+  ParsedPath *getPath(const Global &Global, llvm::StringRef SerializedPath);
+
+  std::optional<uint64_t> getHash(const Global &Global, ParsedPath &Path) {
+    if (not Path.Hashed) {
+      Path.Hash = Global.hashPath(Path.Path);
+      Path.Hashed = true;
+    }
+    return Path.Hash;
+  }
+};
+
+class ContainerInvalidationMetadata {
+public:
+  struct ValueType {
+    pipeline::TargetInPipe Target;
+    std::vector<std::string> ReadPaths;
+
+    /// The hash of each of the entries of ReadPaths at the time the metadata
+    /// was stored, 0 if the path did not exist. It is empty for metadata that
+    /// has been produced without hashes, in which case the target is always
+    /// assumed to be up to date.
+    std::vector<uint64_t> Hashes;
+  };
+  using Vector = std::vector<ValueType>;
+  Vector Data;
+
+  void merge(ContainerInvalidationMetadata &&Other) {
+    for (ValueType &Entry : Other.Data)
+      Data.emplace_back(std::move(Entry));
+  }
+
+public:
+  /// \param Stale targets that read paths whose hash no longer matches the
+  ///              current content of \p Primitives
+  llvm::Expected<PathTargetBimap>
+  deserialize(const Context &Ctx,
+              const Global &Primitives,
+              llvm::StringRef PipeName,
+              llvm::StringRef ContainerName,
+              InvalidationMetadataCache &Cache,
+              TargetsList &Stale) const;
+
+  static ContainerInvalidationMetadata
+  serialize(const TargetsInterner &Interner,
+            const PathTargetBimap &Map,
+            const Global &Primitives,
+            llvm::StringRef PipeName,
+            llvm::StringRef ContainerName);
+};
+
+class NamedPathTargetBimapVector {
+public:
+  std::string GlobalName;
+  ContainerInvalidationMetadata Map;
+};
+
+/// Content of the invalidation metadata file of a container
+using InvalidationMetadataVector = llvm::SmallVector<NamedPathTargetBimapVector,
+                                                     2>;
+} // namespace pipeline
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(
+  pipeline::ContainerInvalidationMetadata::ValueType);
+
+namespace llvm {
+namespace yaml {
+
+// YAML traits for TargetInContainer
+template<>
+struct MappingTraits<pipeline::TargetInPipe> {
+  static void mapping(IO &IO, pipeline::TargetInPipe &TargetInContainer) {
+    IO.mapRequired("Target", TargetInContainer.SerializedTarget);
+    IO.mapRequired("PipeName", TargetInContainer.PipeName);
+  }
+};
+
+template<>
+struct MappingTraits<pipeline::ContainerInvalidationMetadata> {
+  static void mapping(IO &Io,
+                      pipeline::ContainerInvalidationMetadata &TargetMap) {
+    Io.mapRequired("Map", TargetMap.Data);
+  }
+};
+
+template<>
+struct MappingTraits<pipeline::ContainerInvalidationMetadata::ValueType> {
+  static void
+  mapping(IO &Io,
+          pipeline::ContainerInvalidationMetadata::Vector::value_type
+            &TargetMap) {
+    Io.mapRequired("Target", TargetMap.Target.SerializedTarget);
+    Io.mapRequired("PipeName", TargetMap.Target.PipeName);
+    Io.mapRequired("ReadPaths", TargetMap.ReadPaths);
+    Io.mapOptional("Hashes", TargetMap.Hashes);
+  }
+};
+
+} // namespace yaml
+} // namespace llvm
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(pipeline::NamedPathTargetBimapVector);
+
+namespace llvm {
+namespace yaml {
+template<>
+struct MappingTraits<pipeline::NamedPathTargetBimapVector> {
+  static void mapping(IO &Io, pipeline::NamedPathTargetBimapVector &TargetMap) {
+    Io.mapRequired("GlobalName", TargetMap.GlobalName);
+    Io.mapRequired("Map", TargetMap.Map.Data);
+  }
+};
+} // namespace yaml
+} // namespace llvm
+
+/// The binary format of the invalidation metadata of a container.
+///
+/// All the strings (global names, serialized targets, pipe names and paths) are
+/// interned in a table at the beginning of the file and referenced by index
+/// afterwards. All the numbers are ULEB128-encoded, except for the hashes,
+/// which are 64-bit little endian:
+///
+///     Magic Version
+///     StringsCount (Size Bytes)*
+///     GlobalsCount (GlobalName EntriesCount Entry*)*
+///
+/// where each Entry is:
+///
+///     Target PipeName PathsCount Path* HasHashes Hash*
+namespace pipeline::binary_metadata {
+
+/// \return true if \p Buffer starts with the header of the binary format
+bool isBinary(llvm::StringRef Buffer);
+
+void write(llvm::raw_ostream &OS, const InvalidationMetadataVector &ToStore);
+
+/// Parses \p Buffer, failing on anything that is not a well-formed file in
+/// the binary format, including trailing garbage
+llvm::Expected<InvalidationMetadataVector> read(llvm::StringRef Buffer);
+
+} // namespace pipeline::binary_metadata
@@ -4,13 +4,24 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <optional>
 #include <string>
 #include <tuple>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/YAMLTraits.h"
 
 #include "revng/Pipeline/Target.h"
+#include "revng/Support/Assert.h"
 #include "revng/TupleTree/TupleTreePath.h"
 
 namespace pipeline {
@@ -45,16 +56,130 @@ public:
   }
 };
 
+/// Assigns a dense 32-bit identifier to each distinct TargetInContainer, so
+/// that data structures that need to refer to the same target many times can
+/// store a single integer rather than a copy of its path components.
+///
+/// Identifiers are only meaningful for the interner that produced them, and
+/// are stable until compact is invoked.
+class TargetsInterner {
+public:
+  using ID = uint32_t;
+
+  /// Returned by compact for the targets that have been dropped
+  static constexpr ID Dropped = std::numeric_limits<ID>::max();
+
+private:
+  struct PointeeLess {
+    using is_transparent = void;
+
+    bool operator()(const TargetInContainer *LHS,
+                    const TargetInContainer *RHS) const {
+      return *LHS < *RHS;
+    }
+
+    bool operator()(const TargetInContainer &LHS,
+                    const TargetInContainer *RHS) const {
+      return LHS < *RHS;
+    }
+
+    bool operator()(const TargetInContainer *LHS,
+                    const TargetInContainer &RHS) const {
+      return *LHS < RHS;
+    }
+  };
+
+private:
+  /// The interned targets, indexed by ID. Each target is stored only here: a
+  /// deque never moves its elements, hence IDs can point into it.
+  std::deque<TargetInContainer> Targets;
+  std::map<const TargetInContainer *, ID, PointeeLess> IDs;
+
+public:
+  TargetsInterner() = default;
+  TargetsInterner(const TargetsInterner &Other) : Targets(Other.Targets) {
+    reindex();
+  }
+  TargetsInterner(TargetsInterner &&) = default;
+  TargetsInterner &operator=(const TargetsInterner &Other) {
+    if (this != &Other) {
+      Targets = Other.Targets;
+      reindex();
+    }
+    return *this;
+  }
+  TargetsInterner &operator=(TargetsInterner &&) = default;
+
+public:
+  ID intern(const TargetInContainer &Target) {
+    auto It = IDs.find(Target);
+    if (It != IDs.end())
+      return It->second;
+
+    revng_assert(Targets.size() < Dropped);
+    ID NewID = Targets.size();
+    Targets.push_back(Target);
+    IDs.emplace(&Targets.back(), NewID);
+    return NewID;
+  }
+
+  std::optional<ID> lookup(const TargetInContainer &Target) const {
+    auto It = IDs.find(Target);
+    if (It == IDs.end())
+      return std::nullopt;
+    return It->second;
+  }
+
+  const TargetInContainer &get(ID TheID) const {
+    revng_assert(TheID < Targets.size());
+    return Targets[TheID];
+  }
+
+  size_t size() const { return Targets.size(); }
+
+  /// Drops the targets whose ID is not set in \p Live and renumbers the others,
+  /// preserving their order. All the users of the identifiers must then be
+  /// updated.
+  ///
+  /// \return the new ID of each of the old ones, or Dropped.
+  std::vector<ID> compact(const llvm::BitVector &Live) {
+    std::vector<ID> NewIDs(Targets.size(), Dropped);
+    std::deque<TargetInContainer> Compacted;
+    for (ID OldID = 0; OldID < Targets.size(); ++OldID) {
+      if (OldID < Live.size() and Live.test(OldID)) {
+        NewIDs[OldID] = Compacted.size();
+        Compacted.push_back(std::move(Targets[OldID]));
+      }
+    }
+
+    Targets = std::move(Compacted);
+    reindex();
+    return NewIDs;
+  }
+
+private:
+  void reindex() {
+    IDs.clear();
+    for (ID TheID = 0; TheID < Targets.size(); ++TheID)
+      IDs.emplace(&Targets[TheID], TheID);
+  }
+};
+
 /// A PathTargetBimap is a many to many relationship between a TupleTreePaths
 /// and TargetInContainer. It can be queried both ways, so from a target and a
 /// container you can get the list of tuple tree paths that contribuited to that
 /// target in that container, and from a tuple tree path you can know all the
 /// targets that have been created reading the field pointed by that path.
+///
+/// Targets are stored as identifiers obtained from the TargetsInterner of the
+/// pipeline::Context.
 class PathTargetBimap {
+public:
+  using TargetID = TargetsInterner::ID;
+
 private:
-  using MapType = std::map<TupleTreePath, std::set<TargetInContainer>>;
-  using ReverseMapType = std::map<TargetInContainer,
-                                  std::vector<TupleTreePath>>;
+  using MapType = std::map<TupleTreePath, llvm::DenseSet<TargetID>>;
+  using ReverseMapType = llvm::DenseMap<TargetID, std::vector<TupleTreePath>>;
   MapType Map;
   // When we will instrument the entire pipeline there will not be any longer a
   // need to have a reverse map, since it will only be inspected at load time of
@@ -76,44 +201,74 @@ public:
 public:
   void merge(PathTargetBimap &&Other) {
     for (auto &Entry : Other.Map)
-      for (auto &Target : Entry.second)
-        insert(std::move(Target), std::move(Entry.first));
+      for (TargetID Target : Entry.second)
+        insert(Target, Entry.first);
   }
 
 public:
-  void clear() { Map = MapType(); }
+  void clear() {
+    Map = MapType();
+    ReverseMap = ReverseMapType();
+  }
 
-  void insert(const TargetInContainer &TargetInContainer,
-              const TupleTreePath &Path) {
-    Map[Path].insert(TargetInContainer);
-    ReverseMap[TargetInContainer].push_back(Path);
+  void insert(TargetID Target, const TupleTreePath &Path) {
+    Map[Path].insert(Target);
+    ReverseMap[Target].push_back(Path);
   }
 
-  void insert(const Target &Target,
-              const std::string &ContainerName,
-              const TupleTreePath &Path) {
-    TargetInContainer Located(Target, ContainerName);
-    insert(Located, Path);
+  void remove(TargetID Target) {
+    auto Iter = ReverseMap.find(Target);
+    if (Iter == ReverseMap.end())
+      return;
+
+    for (auto &Path : Iter->second)
+      Map.at(Path).erase(Target);
+
+    ReverseMap.erase(Iter);
   }
 
-  void remove(const TargetsList &List, llvm::StringRef ContainerName) {
+  void remove(const TargetsInterner &Interner,
+              const TargetsList &List,
+              llvm::StringRef ContainerName) {
     for (auto &Target : List) {
       TargetInContainer ToErase(Target, ContainerName.str());
-      auto Iter = ReverseMap.find(ToErase);
-      if (Iter == ReverseMap.end())
-        continue;
+      if (auto MaybeID = Interner.lookup(ToErase))
+        remove(*MaybeID);
+    }
+  }
 
-      for (auto &Path : Iter->second) {
-        Map.at(Path).erase(ToErase);
-      }
+public:
+  bool contains(TargetID Target) const { return ReverseMap.count(Target) != 0; }
 
-      ReverseMap.erase(Iter);
+public:
+  /// Sets the bits of \p Live corresponding to the targets in this map
+  void collectTargets(llvm::BitVector &Live) const {
+    for (const auto &Entry : ReverseMap) {
+      revng_assert(Entry.first < Live.size());
+      Live.set(Entry.first);
     }
   }
 
-public:
-  bool contains(const TargetInContainer &Target) const {
-    return ReverseMap.find(Target) != ReverseMap.end();
+  /// Renumbers the targets as returned by TargetsInterner::compact
+  void remapTargets(llvm::ArrayRef<TargetID> NewIDs) {
+    auto Remap = [NewIDs](TargetID Old) {
+      revng_assert(Old < NewIDs.size());
+      TargetID New = NewIDs[Old];
+      revng_assert(New != TargetsInterner::Dropped);
+      return New;
+    };
+
+    for (auto &Entry : Map) {
+      llvm::DenseSet<TargetID> Remapped;
+      for (TargetID Target : Entry.second)
+        Remapped.insert(Remap(Target));
+      Entry.second = std::move(Remapped);
+    }
+
+    ReverseMapType NewReverseMap;
+    for (auto &Entry : ReverseMap)
+      NewReverseMap[Remap(Entry.first)] = std::move(Entry.second);
+    ReverseMap = std::move(NewReverseMap);
   }
 };
 
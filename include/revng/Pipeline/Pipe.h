@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
@@ -209,7 +210,7 @@ struct PipeWrapper {
     llvm::StringMap<PathTargetBimap> PathCache;
 
   public:
-    void registerTargetsDependingOn(const Context &Ctx,
+    void registerTargetsDependingOn(const TargetsInterner &Interner,
                                     llvm::StringRef GlobalName,
                                     const TupleTreePath &Path,
                                     ContainerToTargetsMap &Out) const {
@@ -220,28 +221,41 @@ struct PipeWrapper {
         if (It == Bimap.end())
           return;
 
-        for (const auto &Entry : It->second)
-          Out.add(Entry.getContainerName(), Entry.getTarget());
+        llvm::StringMap<TargetsList::List> Found;
+        for (TargetsInterner::ID ID : It->second) {
+          const TargetInContainer &Entry = Interner.get(ID);
+          Found[Entry.getContainerName()].push_back(Entry.getTarget());
+        }
+
+        for (auto &Pair : Found)
+          Out[Pair.first()].merge(TargetsList(std::move(Pair.second)));
       }
     }
 
-    void remove(const ContainerToTargetsMap &Map) {
-      for (auto &Pair : Map) {
-        auto Iter = PathCache.find(Pair.first());
-        if (Iter == PathCache.end())
-          continue;
-
-        Iter->second.remove(Pair.second, Pair.first());
-      }
+    void remove(const TargetsInterner &Interner,
+                const ContainerToTargetsMap &Map) {
+      for (auto &Pair : Map)
+        for (auto &Entry : PathCache)
+          Entry.second.remove(Interner, Pair.second, Pair.first());
     }
 
     bool contains(llvm::StringRef GlobalName,
-                  const TargetInContainer &Target) const {
+                  TargetsInterner::ID Target) const {
       if (auto Iter = PathCache.find(GlobalName); Iter != PathCache.end())
         return Iter->second.contains(Target);
       return false;
     }
 
+    void collectTargets(llvm::BitVector &Live) const {
+      for (const auto &Entry : PathCache)
+        Entry.second.collectTargets(Live);
+    }
+
+    void remapTargets(llvm::ArrayRef<TargetsInterner::ID> NewIDs) {
+      for (auto &Entry : PathCache)
+        Entry.second.remapTargets(NewIDs);
+    }
+
     const llvm::StringMap<PathTargetBimap> &getPathCache() const {
       return PathCache;
     }
@@ -43,6 +43,9 @@ private:
   Vector ReversePostOrderIndexes;
   llvm::StringMap<AnalysesList> AnalysesLists;
 
+  /// Size of the TargetsInterner of the context after the last compaction
+  size_t CompactedInternerSize = 0;
+
 public:
   template<typename T>
   using DereferenceIteratorType = ::revng::DereferenceIteratorType<T>;
@@ -208,6 +211,12 @@ public:
   llvm::Error invalidate(const Target &Target);
   llvm::Error invalidate(const pipeline::TargetInStepSet &Invalidations);
 
+private:
+  /// Drops from the TargetsInterner of the context the targets that are no
+  /// longer referenced by any step, once it has doubled in size since the last
+  /// time, so that it does not grow unbounded across invalidations
+  void compactTargetsInterner();
+
 public:
   llvm::Error store(const revng::DirectoryPath &DirPath) const;
   llvm::Error dump(const char *DirPath) const debug_function {
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
@@ -106,8 +107,9 @@ public:
                                   const TupleTreePath &Path,
                                   TargetInStepSet &Out) const {
     ContainerToTargetsMap OutMap;
+    const TargetsInterner &Interner = Ctx->getTargetsInterner();
     for (const PipeWrapper &Pipe : Pipes) {
-      Pipe.InvalidationMetadata.registerTargetsDependingOn(*Ctx,
+      Pipe.InvalidationMetadata.registerTargetsDependingOn(Interner,
                                                            GlobalName,
                                                            Path,
                                                            OutMap);
@@ -123,19 +125,37 @@ public:
 
   bool invalidationMetadataContains(llvm::StringRef GlobalName,
                                     const TargetInContainer &Target) const {
+    auto MaybeID = Ctx->getTargetsInterner().lookup(Target);
+    if (not MaybeID)
+      return false;
+
     for (const PipeWrapper &Pipe : Pipes) {
-      if (Pipe.InvalidationMetadata.contains(GlobalName, Target))
+      if (Pipe.InvalidationMetadata.contains(GlobalName, *MaybeID))
         return true;
     }
     return false;
   }
 
+  /// Sets the bits of \p Live corresponding to the targets referenced by the
+  /// invalidation metadata
+  void collectTargets(llvm::BitVector &Live) const {
+    for (const PipeWrapper &Pipe : Pipes)
+      Pipe.InvalidationMetadata.collectTargets(Live);
+  }
+
+  void remapTargets(llvm::ArrayRef<TargetsInterner::ID> NewIDs) {
+    for (PipeWrapper &Pipe : Pipes)
+      Pipe.InvalidationMetadata.remapTargets(NewIDs);
+  }
+
 private:
   llvm::Error loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
-                                           ContainerSet::value_type &Pair);
+                                           ContainerSet::value_type &Pair,
+                                           TargetsList &Stale);
 
 private:
-  llvm::Error loadInvalidationMetadata(const revng::DirectoryPath &Path);
+  llvm::Error loadInvalidationMetadata(const revng::DirectoryPath &Path,
+                                       ContainerToTargetsMap &Stale);
 
   llvm::Error storeInvalidationMetadata(const revng::DirectoryPath &Path) const;
 
@@ -270,7 +290,13 @@ public:
 
 public:
   llvm::Error store(const revng::DirectoryPath &DirPath) const;
-  llvm::Error load(const revng::DirectoryPath &DirPath);
+
+  /// Loads the containers and the invalidation metadata from \p DirPath.
+  ///
+  /// The targets that have read parts of the globals whose content differs
+  /// from the time they were stored are added to \p Stale.
+  llvm::Error load(const revng::DirectoryPath &DirPath,
+                   ContainerToTargetsMap &Stale);
 
   std::vector<revng::FilePath>
   getWrittenFiles(const revng::DirectoryPath &DirPath) const;
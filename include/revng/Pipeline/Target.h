@@ -138,6 +138,9 @@ llvm::Error parseTarget(const Context &Ctx,
                         TargetsList &Out);
 
 /// a sorted list of targets.
+///
+/// Inserting a single target costs a full sort of the list, when inserting many
+/// targets at once use batch_insert() instead.
 class TargetsList {
 public:
   using List = llvm::SmallVector<Target, 4>;
@@ -153,7 +156,7 @@ private:
 
 public:
   TargetsList() = default;
-  TargetsList(List C) : Contained(std::move(C)) {}
+  TargetsList(List C) : Contained(std::move(C)) { sortAndUnique(); }
   static TargetsList allTargets(const Context &Ctx, const Kind &K) {
     TargetsList ToReturn;
     K.appendAllTargets(Ctx, ToReturn);
@@ -205,20 +208,71 @@ public:
   template<typename... Args>
   void emplace_back(Args &&...A) {
     Contained.emplace_back(std::forward<Args>(A)...);
-    llvm::sort(Contained);
-    Contained.erase(unique(Contained.begin(), Contained.end()),
-                    Contained.end());
+    sortAndUnique();
   }
 
   void merge(const TargetsList &Other);
 
   void push_back(const Target &Target) {
     Contained.push_back(Target);
-    llvm::sort(Contained);
-    Contained.erase(unique(Contained.begin(), Contained.end()),
-                    Contained.end());
+    sortAndUnique();
   }
 
+public:
+  /// Appends targets to a TargetsList deferring the sorting to when the
+  /// inserter is committed or destroyed. The list must not be inspected in the
+  /// meantime.
+  class BatchInserter {
+  private:
+    TargetsList *TL;
+    size_t OriginalSize;
+
+  public:
+    BatchInserter(TargetsList &TL) : TL(&TL), OriginalSize(TL.size()) {}
+
+    BatchInserter(const BatchInserter &) = delete;
+    BatchInserter &operator=(const BatchInserter &) = delete;
+
+    BatchInserter(BatchInserter &&Other) :
+      TL(Other.TL), OriginalSize(Other.OriginalSize) {
+      Other.TL = nullptr;
+    }
+
+    BatchInserter &operator=(BatchInserter &&Other) {
+      commit();
+      TL = Other.TL;
+      OriginalSize = Other.OriginalSize;
+      Other.TL = nullptr;
+      return *this;
+    }
+
+    ~BatchInserter() { commit(); }
+
+  public:
+    void reserve(size_t Count) {
+      revng_assert(TL != nullptr);
+      TL->Contained.reserve(TL->size() + Count);
+    }
+
+    template<typename... Args>
+    void emplace(Args &&...A) {
+      revng_assert(TL != nullptr);
+      TL->Contained.emplace_back(std::forward<Args>(A)...);
+    }
+
+    void insert(const Target &Target) { emplace(Target); }
+
+    void commit() {
+      if (TL == nullptr)
+        return;
+
+      TL->sortAndMergeTail(OriginalSize);
+      TL = nullptr;
+    }
+  };
+
+  BatchInserter batch_insert() { return BatchInserter(*this); }
+
   template<typename... Args>
   auto erase(Args &&...A) {
     return Contained.erase(std::forward<Args>(A)...);
@@ -231,10 +285,22 @@ public:
                           Other.begin(),
                           Other.end(),
                           std::back_inserter(ToReturn.Contained));
-    llvm::sort(ToReturn.Contained);
     return ToReturn;
   }
 
+private:
+  void sortAndUnique() { sortAndMergeTail(0); }
+
+  /// Sorts the elements starting from \p SortedPrefixSize, merges them with
+  /// the already sorted prefix and drops duplicates
+  void sortAndMergeTail(size_t SortedPrefixSize) {
+    auto Middle = Contained.begin() + SortedPrefixSize;
+    std::sort(Middle, Contained.end());
+    std::inplace_merge(Contained.begin(), Middle, Contained.end());
+    Contained.erase(unique(Contained.begin(), Contained.end()),
+                    Contained.end());
+  }
+
 private:
   struct Comp {
     bool operator()(const Target &T, const Kind &K) const {
@@ -356,8 +422,7 @@ public:
   }
 
   void add(llvm::StringRef Name, const TargetsList &Targets) {
-    for (const auto &Target : Targets)
-      Status[Name].emplace_back(Target);
+    Status[Name].merge(Targets);
   }
 
 public:
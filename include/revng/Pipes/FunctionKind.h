@@ -19,8 +19,10 @@ public:
                         pipeline::TargetsList &Out) const override {
     using namespace pipeline;
     const auto &Model = getModelFromContext(Ctx);
+    auto Inserter = Out.batch_insert();
+    Inserter.reserve(Model->Functions().size());
     for (const auto &Function : Model->Functions()) {
-      Out.push_back(Target(Function.Entry().toString(), *this));
+      Inserter.emplace(Function.Entry().toString(), *this);
     }
   }
 };
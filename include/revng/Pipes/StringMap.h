@@ -5,10 +5,16 @@
 //
 
 #include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
 #include <utility>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/YAMLTraits.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/Pipeline/Container.h"
 #include "revng/Pipeline/ContainerSet.h"
@@ -18,6 +24,7 @@
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Pipes/TypeKind.h"
+#include "revng/Support/GzipStream.h"
 #include "revng/Support/GzipTarFile.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/MetaAddress/YAMLTraits.h"
@@ -26,6 +33,7 @@
 
 namespace detail {
 
+/// Position of the data of a file in a GzipTarWriter archive, End is inclusive
 struct DataOffset {
   size_t UncompressedSize;
   size_t Start;
@@ -35,6 +43,48 @@ struct DataOffset {
 template<typename T>
 using OffsetMap = std::map<T, DataOffset>;
 
+/// Index of a GzipTarWriter archive. Each archive is written with a random
+/// token, stored both in the index and, uncompressed, at TokenOffset in the
+/// archive. Together with the size of the archive, it allows to detect indexes
+/// that do not match the archive next to them without reading the archive.
+template<typename T>
+struct ArchiveIndex {
+  uint64_t ArchiveSize = 0;
+  std::string Token;
+  uint64_t TokenOffset = 0;
+  OffsetMap<T> Members;
+};
+
+/// \return a random token to tie an index to the archive written with it
+inline std::string makeArchiveToken() {
+  std::random_device Device;
+  std::string Result;
+  llvm::raw_string_ostream OS(Result);
+  for (int I = 0; I < 4; ++I)
+    OS << llvm::format_hex_no_prefix(Device(), 8);
+  OS.flush();
+  return Result;
+}
+
+/// Forwards everything to another stream, counting the bytes written so far
+class CountingOstream : public llvm::raw_ostream {
+private:
+  llvm::raw_ostream &OS;
+  uint64_t Size = 0;
+
+public:
+  CountingOstream(llvm::raw_ostream &OS) : OS(OS) {}
+  ~CountingOstream() override { flush(); }
+
+private:
+  void write_impl(const char *Ptr, size_t Length) override {
+    Size += Length;
+    OS.write(Ptr, Length);
+  }
+
+  uint64_t current_pos() const override { return Size; }
+};
+
 } // namespace detail
 
 namespace llvm::yaml {
@@ -65,12 +115,32 @@ struct CustomMappingTraits<::detail::OffsetMap<T>> {
   }
 };
 
+template<typename T>
+  requires HasScalarTraits<T>
+struct MappingTraits<::detail::ArchiveIndex<T>> {
+  static void mapping(IO &IO, ::detail::ArchiveIndex<T> &Value) {
+    IO.mapRequired("ArchiveSize", Value.ArchiveSize);
+    IO.mapRequired("Token", Value.Token);
+    IO.mapRequired("TokenOffset", Value.TokenOffset);
+    IO.mapRequired("Members", Value.Members);
+  }
+};
+
 } // namespace llvm::yaml
 
 namespace revng::pipes {
 
 namespace detail {
 
+/// Container mapping keys of the given rank to strings, stored as a gzipped tar
+/// archive with one file per key and an index file with the position of each
+/// file in the archive.
+///
+/// When the index is available, load maps the archive in memory and inflates
+/// each entry only upon first access, so that extracting a handful of entries
+/// from a large container does not require decompressing it entirely. Since
+/// this happens in const methods too, the container must not be accessed
+/// concurrently.
 template<auto *Rank,
          auto *K,
          const char *TypeName,
@@ -98,7 +168,18 @@ public:
 
 private:
   using OffsetMap = ::detail::OffsetMap<KeyType>;
-  MapType Map;
+  using ArchiveIndex = ::detail::ArchiveIndex<KeyType>;
+
+  /// Entries that are available in memory
+  mutable MapType Map;
+
+  /// The archive this container has been loaded from, if it still has entries
+  /// that have not been inflated
+  mutable std::shared_ptr<const llvm::MemoryBuffer> Archive;
+
+  /// Position in Archive of the entries that have not been inflated yet. The
+  /// keys are never in Map at the same time.
+  mutable OffsetMap Pending;
 
 public:
   inline static char ID = '0';
@@ -118,22 +199,31 @@ public:
   ~GenericStringMap() override = default;
 
 public:
-  void clear() override { Map.clear(); }
+  void clear() override {
+    Map.clear();
+    Pending.clear();
+    Archive.reset();
+  }
 
   std::unique_ptr<pipeline::ContainerBase>
   cloneFiltered(const pipeline::TargetsList &Targets) const override {
-    auto Clone = std::make_unique<GenericStringMap>(*this);
-
-    // Returns true if Targets contains a Target that matches the Entry in the
-    // Map
-    const auto EntryIsInTargets = [&](const auto &Entry) {
-      const auto &Key = Entry.first;
-      pipeline::Target EntryTarget{ keyToString(Key), *K };
-      return Targets.contains(EntryTarget);
-    };
+    auto Clone = std::make_unique<GenericStringMap>(this->name());
+
+    // Copy only the entries in Targets, sharing the archive for those that
+    // have not been inflated yet
+    for (const pipeline::Target &Target : Targets) {
+      if (&Target.getKind() != K)
+        continue;
+
+      KeyType Key = keyFromString(Target.getPathComponents().back());
+      if (auto It = Map.find(Key); It != Map.end())
+        Clone->Map.insert(*It);
+      else if (auto PendingIt = Pending.find(Key); PendingIt != Pending.end())
+        Clone->Pending.insert(*PendingIt);
+    }
 
-    // Drop all the entries in Map that are not in Targets
-    std::erase_if(Clone->Map, std::not_fn(EntryIsInTargets));
+    if (not Clone->Pending.empty())
+      Clone->Archive = Archive;
 
     return Clone;
   }
@@ -143,9 +233,16 @@ public:
     revng_check(&Target.getKind() == K);
 
     std::string KeyString = Target.getPathComponents().back();
+    KeyType Key = keyFromString(KeyString);
+
+    // Inflate straight into OS, without keeping the entry in memory
+    if (auto It = Pending.find(Key); It != Pending.end()) {
+      inflate(OS, It->second);
+      return llvm::Error::success();
+    }
 
-    auto It = find(keyFromString(KeyString));
-    revng_check(It != end());
+    auto It = Map.find(Key);
+    revng_check(It != Map.end());
 
     OS << It->second;
 
@@ -156,6 +253,8 @@ public:
     pipeline::TargetsList::List Result;
     for (const auto &[Key, Value] : Map)
       Result.push_back({ keyToString(Key), *K });
+    for (const auto &[Key, Offset] : Pending)
+      Result.push_back({ keyToString(Key), *K });
 
     return Result;
   }
@@ -163,18 +262,16 @@ public:
   bool remove(const pipeline::TargetsList &Targets) override {
     bool Changed = false;
 
-    auto End = Map.end();
     for (const pipeline::Target &T : Targets) {
       revng_assert(&T.getKind() == K);
 
       std::string KeyString = T.getPathComponents().back();
-      auto It = Map.find(keyFromString(KeyString));
-      if (It != End) {
-        Map.erase(It);
+      KeyType Key = keyFromString(KeyString);
+      if (Map.erase(Key) != 0 or Pending.erase(Key) != 0)
         Changed = true;
-      }
     }
 
+    releaseArchiveIfUnused();
     return Changed;
   }
 
@@ -194,7 +291,12 @@ public:
     if (not MaybeWritableFile)
       return MaybeWritableFile.takeError();
 
-    OffsetMap Offsets = serializeWithOffsets(MaybeWritableFile.get()->os());
+    ArchiveIndex Index;
+    {
+      ::detail::CountingOstream OS(MaybeWritableFile.get()->os());
+      Index = serializeWithOffsets(OS, ::detail::makeArchiveToken());
+      Index.ArchiveSize = OS.tell();
+    }
 
     if (auto Error = MaybeWritableFile.get()->commit(); Error)
       return Error;
@@ -203,7 +305,7 @@ public:
     auto MaybeWritableIndexFile = IndexPath.getWritableFile();
     if (!!MaybeWritableIndexFile) {
       llvm::yaml::Output IndexOutput(MaybeWritableIndexFile.get()->os());
-      IndexOutput << Offsets;
+      IndexOutput << Index;
 
       if (auto Error = MaybeWritableIndexFile.get()->commit(); Error)
         return Error;
@@ -228,8 +330,24 @@ public:
     if (not MaybeBuffer)
       return MaybeBuffer.takeError();
 
-    GzipTarReader Reader(MaybeBuffer.get()->buffer());
-    deserializeImpl(Reader);
+    clear();
+
+    std::shared_ptr<revng::ReadableFile> File = std::move(MaybeBuffer.get());
+    auto MaybeOffsets = loadIndex(Path, File->buffer());
+    if (not MaybeOffsets)
+      return MaybeOffsets.takeError();
+
+    if (MaybeOffsets->has_value()) {
+      // Keep the file alive as long as the buffer is in use
+      Archive = std::shared_ptr<const llvm::MemoryBuffer>(File,
+                                                          &File->buffer());
+      Pending = std::move(**MaybeOffsets);
+      releaseArchiveIfUnused();
+    } else {
+      GzipTarReader Reader(File->buffer());
+      deserializeImpl(Reader);
+    }
+
     return llvm::Error::success();
   }
 
@@ -242,21 +360,47 @@ public:
 
 protected:
   void mergeBackImpl(GenericStringMap &&Other) override {
-    // Stuff in Other should overwrite what's in this container.
+    // Only a single archive can back the entries that have not been inflated
+    if (not Pending.empty() and not Other.Pending.empty()
+        and Archive != Other.Archive)
+      Other.materializeAll();
+
+    // Stuff in Other should overwrite what's in this container, whether it has
+    // been inflated or not
+    for (const auto &Entry : Other.Map)
+      Pending.erase(Entry.first);
+    for (const auto &Entry : Other.Pending)
+      Map.erase(Entry.first);
+
     // We first merge this->Map into Other.Map (which keeps Other's version if
     // present), and then we replace this->Map with the newly merged version of
     // Other.Map.
     Other.Map.merge(std::move(this->Map));
     this->Map = std::move(Other.Map);
+
+    if (not Other.Pending.empty())
+      Archive = std::move(Other.Archive);
+    Other.Pending.merge(std::move(this->Pending));
+    this->Pending = std::move(Other.Pending);
+    releaseArchiveIfUnused();
   }
 
 public:
   /// std::map-like methods
 
-  std::string &operator[](KeyType M) { return Map[M]; };
+  std::string &operator[](KeyType M) {
+    materialize(M);
+    return Map[M];
+  };
 
-  std::string &at(KeyType M) { return Map.at(M); };
-  const std::string &at(KeyType M) const { return Map.at(M); };
+  std::string &at(KeyType M) {
+    materialize(M);
+    return Map.at(M);
+  };
+  const std::string &at(KeyType M) const {
+    materialize(M);
+    return Map.at(M);
+  };
 
 private:
   using IteratedValue = std::pair<const KeyType &, std::string &>;
@@ -280,53 +424,210 @@ public:
   };
 
   auto insert_or_assign(KeyType Key, const std::string &Value) {
+    bool WasPending = Pending.erase(Key) != 0;
     auto [Iterator, Success] = Map.insert_or_assign(Key, Value);
-    return std::pair{ revng::map_iterator(Iterator, mapIt), Success };
+    releaseArchiveIfUnused();
+    return std::pair{ revng::map_iterator(Iterator, mapIt),
+                      Success and not WasPending };
   };
   auto insert_or_assign(KeyType Key, std::string &&Value) {
+    bool WasPending = Pending.erase(Key) != 0;
     auto [Iterator, Success] = Map.insert_or_assign(Key, std::move(Value));
-    return std::pair{ revng::map_iterator(Iterator, mapIt), Success };
+    releaseArchiveIfUnused();
+    return std::pair{ revng::map_iterator(Iterator, mapIt),
+                      Success and not WasPending };
   };
 
-  bool contains(KeyType Key) const { return Map.contains(Key); }
+  bool contains(KeyType Key) const {
+    return Map.contains(Key) or Pending.contains(Key);
+  }
 
   auto find(KeyType Key) {
+    materialize(Key);
     return revng::map_iterator(Map.find(Key), this->mapIt);
   }
 
   auto find(KeyType Key) const {
+    materialize(Key);
     return revng::map_iterator(Map.find(Key), this->mapCIt);
   }
 
-  auto begin() { return revng::map_iterator(Map.begin(), this->mapIt); }
-  auto end() { return revng::map_iterator(Map.end(), this->mapIt); }
+  auto begin() {
+    materializeAll();
+    return revng::map_iterator(Map.begin(), this->mapIt);
+  }
+  auto end() {
+    materializeAll();
+    return revng::map_iterator(Map.end(), this->mapIt);
+  }
 
-  auto begin() const { return revng::map_iterator(Map.begin(), this->mapCIt); }
-  auto end() const { return revng::map_iterator(Map.end(), this->mapCIt); }
+  auto begin() const {
+    materializeAll();
+    return revng::map_iterator(Map.begin(), this->mapCIt);
+  }
+  auto end() const {
+    materializeAll();
+    return revng::map_iterator(Map.end(), this->mapCIt);
+  }
 
 private:
+  void inflate(llvm::raw_ostream &OS,
+               const ::detail::DataOffset &Offset) const {
+    revng_assert(Archive != nullptr);
+    const char *Start = Archive->getBufferStart() + Offset.Start;
+    gzipDecompress(OS, { Start, Offset.End - Offset.Start + 1 });
+  }
+
+  std::string inflate(const ::detail::DataOffset &Offset) const {
+    std::string Result;
+    Result.reserve(Offset.UncompressedSize);
+    llvm::raw_string_ostream OS(Result);
+    inflate(OS, Offset);
+    OS.flush();
+    revng_assert(Result.size() == Offset.UncompressedSize);
+    return Result;
+  }
+
+  /// Moves the entry of \p Key to Map, if it has not been inflated yet
+  void materialize(const KeyType &Key) const {
+    auto It = Pending.find(Key);
+    if (It == Pending.end())
+      return;
+
+    Map.emplace(Key, inflate(It->second));
+    Pending.erase(It);
+    releaseArchiveIfUnused();
+  }
+
+  void materializeAll() const {
+    // Inflate all the entries in parallel
+    std::vector<llvm::ArrayRef<char>> Compressed;
+    Compressed.reserve(Pending.size());
+    for (const auto &[Key, Offset] : Pending) {
+      const char *Start = Archive->getBufferStart() + Offset.Start;
+      Compressed.emplace_back(Start, Offset.End - Offset.Start + 1);
+    }
+
+    std::vector<std::string> Inflated = revng::inflateMembers(Compressed);
+    auto InflatedIt = Inflated.begin();
+    for (const auto &[Key, Offset] : Pending) {
+      revng_assert(InflatedIt->size() == Offset.UncompressedSize);
+      Map.emplace(Key, std::move(*InflatedIt++));
+    }
+    Pending.clear();
+    releaseArchiveIfUnused();
+  }
+
+  void releaseArchiveIfUnused() const {
+    if (Pending.empty())
+      Archive.reset();
+  }
+
+  /// Loads the index of the archive in \p Path, if available and consistent
+  /// with \p Archive
+  static llvm::Expected<std::optional<OffsetMap>>
+  loadIndex(const revng::FilePath &Path, const llvm::MemoryBuffer &Archive) {
+    revng::FilePath IndexPath = Path.addExtension("idx");
+    auto MaybeExists = IndexPath.exists();
+    if (not MaybeExists)
+      return MaybeExists.takeError();
+
+    if (not MaybeExists.get())
+      return std::nullopt;
+
+    auto MaybeIndexFile = IndexPath.getReadableFile();
+    if (not MaybeIndexFile)
+      return MaybeIndexFile.takeError();
+
+    ArchiveIndex Index;
+    llvm::yaml::Input IndexInput(MaybeIndexFile.get()->buffer().getBuffer());
+    IndexInput >> Index;
+    if (IndexInput.error())
+      return std::nullopt;
+
+    // Make sure the index has been written together with this very archive.
+    // Only the page holding the token is read.
+    llvm::StringRef Data = Archive.getBuffer();
+    if (Index.ArchiveSize != Data.size() or Index.Token.empty())
+      return std::nullopt;
+
+    llvm::StringRef Token = Data.substr(Index.TokenOffset,
+                                        Index.Token.size() + 1);
+    if (Token != (Index.Token + '\0'))
+      return std::nullopt;
+
+    for (const auto &[Key, Offset] : Index.Members)
+      if (Offset.Start > Offset.End or Offset.End >= Data.size())
+        return std::nullopt;
+
+    return std::move(Index.Members);
+  }
+
   void deserializeImpl(GzipTarReader &Reader) {
     for (ArchiveEntry &Entry : Reader.entries()) {
       llvm::StringRef Name = Entry.Filename;
       revng_assert(Name.consume_back(ArchiveSuffix));
       KeyType Key = keyFromString(Name);
       std::string Data = std::string(Entry.Data.data(), Entry.Data.size());
+      Pending.erase(Key);
       Map[Key] = Data;
     }
+    releaseArchiveIfUnused();
   }
 
-  OffsetMap serializeWithOffsets(llvm::raw_ostream &OS) const {
-    OffsetMap Result;
+  /// \param Token if not empty, stored in the archive for the index to refer
+  ///        to it.
+  ArchiveIndex serializeWithOffsets(llvm::raw_ostream &OS,
+                                    llvm::StringRef Token = "") const {
+    std::vector<const KeyType *> Keys;
+    std::vector<std::string> Names;
+    std::vector<revng::ArchiveMember> Members;
+    Keys.reserve(Map.size() + Pending.size());
+    Names.reserve(Map.size() + Pending.size());
+    Members.reserve(Map.size() + Pending.size());
+
+    // Emit the entries sorted by key, regardless of whether they have been
+    // inflated or not, so that the archive does not depend on which entries
+    // have been accessed
+    auto MapIt = Map.begin();
+    auto PendingIt = Pending.begin();
+    while (MapIt != Map.end() or PendingIt != Pending.end()) {
+      bool FromMap = PendingIt == Pending.end()
+                     or (MapIt != Map.end()
+                         and Map.key_comp()(MapIt->first, PendingIt->first));
+
+      if (FromMap) {
+        const auto &[Key, Data] = *MapIt++;
+        Keys.push_back(&Key);
+        Names.push_back(keyToString(Key) + ArchiveSuffix);
+        Members.push_back({ .Name = Names.back(),
+                            .Data = { Data.data(), Data.size() } });
+      } else {
+        // Entries that have not been inflated are copied as they are
+        const auto &[Key, Offset] = *PendingIt++;
+        Keys.push_back(&Key);
+        Names.push_back(keyToString(Key) + ArchiveSuffix);
+        const char *Start = Archive->getBufferStart() + Offset.Start;
+        Members.push_back({ .Name = Names.back(),
+                            .Data = { Start, Offset.End - Offset.Start + 1 },
+                            .UncompressedSize = Offset.UncompressedSize });
+      }
+    }
+
+    // Compress the entries in parallel
     revng::GzipTarWriter Writer(OS);
-    for (auto &[Key, Data] : Map) {
-      std::string Name = keyToString(Key) + ArchiveSuffix;
-      OffsetDescriptor Offsets = Writer.append(Name,
-                                               { Data.data(), Data.size() });
-      Result[Key] = { .UncompressedSize = Data.size(),
-                      .Start = Offsets.DataStart,
-                      .End = Offsets.PaddingStart - 1 };
+    std::vector<OffsetDescriptor> Offsets = Writer.append(Members);
+
+    ArchiveIndex Result;
+    Result.Token = Token.str();
+    Result.TokenOffset = Writer.close(Token);
+    for (size_t I = 0; I < Members.size(); ++I) {
+      size_t Size = Members[I].UncompressedSize.value_or(Members[I]
+                                                           .Data.size());
+      Result.Members[*Keys[I]] = { .UncompressedSize = Size,
+                                   .Start = Offsets[I].DataStart,
+                                   .End = Offsets[I].PaddingStart - 1 };
     }
-    Writer.close();
 
     return Result;
   }
@@ -19,8 +19,10 @@ public:
                         pipeline::TargetsList &Out) const override {
     using namespace pipeline;
     const auto &Model = getModelFromContext(Ctx);
+    auto Inserter = Out.batch_insert();
+    Inserter.reserve(Model->Types().size());
     for (const auto &Type : Model->Types()) {
-      Out.push_back(Target(serializeToString(Type->key()), *this));
+      Inserter.emplace(serializeToString(Type->key()), *this);
     }
   }
 };
@@ -13,6 +13,7 @@
 
 #include "revng/ADT/GenericGraph.h"
 #include "revng/Model/Register.h"
+#include "revng/RegisterUsageAnalyses/RegisterSet.h"
 
 template<>
 struct llvm::DenseMapInfo<model::Register::Values> {
@@ -146,6 +147,14 @@ public:
     }
   }
 
+  cppcoro::generator<model::Register::Values>
+  registersInSet(const RegisterSet &Set) {
+    for (size_t Index = 0; Index < Set.size(); ++Index) {
+      if (Set[Index])
+        co_yield registerByIndex(Index);
+    }
+  }
+
   std::string toString(const Operation &Operation) const {
     auto Register = registerByIndex(Operation.Target);
     return (OperationType::getName(Operation.Type).str() + "("
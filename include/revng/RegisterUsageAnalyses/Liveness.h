@@ -4,17 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include "llvm/ADT/BitVector.h"
-
 #include "revng/MFP/MFP.h"
 #include "revng/RegisterUsageAnalyses/Function.h"
+#include "revng/RegisterUsageAnalyses/RegisterSet.h"
 
 namespace rua {
 
 class Liveness {
 private:
-  using Set = llvm::BitVector;
-  using RegisterSet = Set;
+  using Set = RegisterSet;
 
 public:
   using LatticeElement = Set;
@@ -33,7 +31,7 @@ public:
       }
     }
 
-    Default.resize(Max + 1);
+    Default = Set(Max + 1);
   }
 
 public:
@@ -48,9 +46,7 @@ public:
 
   bool isLessOrEqual(const Set &LHS, const Set &RHS) const {
     // RHS must contain or be equal to LHS
-    Set Intersection = RHS;
-    Intersection &= LHS;
-    return Intersection == LHS;
+    return LHS.isSubsetOf(RHS);
   }
 
   RegisterSet applyTransferFunction(const BlockNode *Block,
@@ -32,6 +32,11 @@ struct RegisterWriters {
     Read &= Other.Read;
     return *this;
   }
+
+  /// \return true if both sets are contained in the ones of \p Other
+  bool isSubsetOf(const RegisterWriters &Other) const {
+    return not Reaching.test(Other.Reaching) and not Read.test(Other.Read);
+  }
 };
 
 /// One entry per register
@@ -98,9 +103,8 @@ public:
 
     unsigned Index = 0;
     for (const auto &[AtPoint, AtSink] : zip(ProgramPoint, Sink)) {
-      auto Unread = AtSink.Read;
-      Unread.flip();
-      Result[Index] = AtPoint.Reaching.anyCommon(Unread);
+      // Is there any reaching write that is not read?
+      Result[Index] = AtPoint.Reaching.test(AtSink.Read);
       ++Index;
     }
 
@@ -120,12 +124,9 @@ public:
   }
 
   bool isLessOrEqual(const WritersSet &LHS, const WritersSet &RHS) const {
-    for (const auto &[LHSEntry, RHSEntry] : zip(LHS, RHS)) {
-      auto Intersection = LHSEntry;
-      Intersection &= RHSEntry;
-      if (Intersection != LHSEntry)
+    for (const auto &[LHSEntry, RHSEntry] : zip(LHS, RHS))
+      if (not LHSEntry.isSubsetOf(RHSEntry))
         return false;
-    }
 
     return true;
   }
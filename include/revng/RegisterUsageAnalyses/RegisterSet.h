@@ -0,0 +1,89 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "revng/Support/Assert.h"
+
+namespace rua {
+
+/// A set of registers of a rua::Function, identified by their index
+///
+/// Register indices are `uint8_t`, therefore any set fits in a fixed number of
+/// words: copying, combining and comparing sets never allocates.
+class RegisterSet {
+private:
+  using Word = uint64_t;
+  static constexpr size_t WordBits = std::numeric_limits<Word>::digits;
+  static constexpr size_t MaxSize = 1 << std::numeric_limits<uint8_t>::digits;
+  static constexpr size_t WordsCount = MaxSize / WordBits;
+
+private:
+  std::array<Word, WordsCount> Words = {};
+
+  /// The number of registers that can be part of the set
+  uint16_t Size = 0;
+
+public:
+  RegisterSet() = default;
+  explicit RegisterSet(size_t Size) : Size(Size) {
+    revng_assert(Size <= MaxSize);
+  }
+
+public:
+  size_t size() const { return Size; }
+
+  bool test(size_t Index) const {
+    revng_assert(Index < Size);
+    return (Words[Index / WordBits] & mask(Index)) != 0;
+  }
+
+  bool operator[](size_t Index) const { return test(Index); }
+
+  void set(size_t Index) {
+    revng_assert(Index < Size);
+    Words[Index / WordBits] |= mask(Index);
+  }
+
+  void reset(size_t Index) {
+    revng_assert(Index < Size);
+    Words[Index / WordBits] &= ~mask(Index);
+  }
+
+  bool any() const {
+    Word Result = 0;
+    for (size_t I = 0; I < WordsCount; ++I)
+      Result |= Words[I];
+    return Result != 0;
+  }
+
+public:
+  RegisterSet &operator|=(const RegisterSet &Other) {
+    revng_assert(Size == Other.Size);
+    for (size_t I = 0; I < WordsCount; ++I)
+      Words[I] |= Other.Words[I];
+    return *this;
+  }
+
+  /// \return true if all the registers in this set are also in \p Other
+  bool isSubsetOf(const RegisterSet &Other) const {
+    revng_assert(Size == Other.Size);
+    Word Missing = 0;
+    for (size_t I = 0; I < WordsCount; ++I)
+      Missing |= Words[I] & ~Other.Words[I];
+    return Missing == 0;
+  }
+
+  bool operator==(const RegisterSet &Other) const = default;
+
+private:
+  static Word mask(size_t Index) { return Word(1) << (Index % WordBits); }
+};
+
+} // namespace rua
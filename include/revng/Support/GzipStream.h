@@ -4,13 +4,26 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstddef>
+
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
 
 void gzipCompress(llvm::raw_ostream &OS,
                   llvm::ArrayRef<uint8_t> Buffer,
                   int CompressionLevel = 3);
 
+/// Offset of the comment in a gzip stream produced by gzipCompressWithComment
+inline constexpr size_t GzipCommentOffset = 10;
+
+/// Like gzipCompress, but stores \p Comment in the header of the gzip stream,
+/// uncompressed and NUL-terminated, starting at GzipCommentOffset. Gzip readers
+/// ignore it.
+void gzipCompressWithComment(llvm::raw_ostream &OS,
+                             llvm::ArrayRef<uint8_t> Buffer,
+                             llvm::StringRef Comment);
+
 inline void gzipCompress(llvm::raw_ostream &OS, llvm::ArrayRef<char> Buffer) {
   return gzipCompress(OS,
                       { reinterpret_cast<const uint8_t *>(Buffer.data()),
@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -29,6 +33,17 @@ struct OffsetDescriptor {
   size_t paddingSize() { return End - PaddingStart; }
 };
 
+/// A file to be added to an archive by GzipTarWriter::append
+struct ArchiveMember {
+  llvm::StringRef Name;
+  llvm::ArrayRef<char> Data;
+
+  /// If set, Data is an already compressed, stand-alone gzip stream of this
+  /// many bytes, such as the data of a file of another archive produced by
+  /// GzipTarWriter
+  std::optional<size_t> UncompressedSize = std::nullopt;
+};
+
 /// Class that allows writing a '.tar.gz' file conforming to the PAX archive
 /// format. The archive is created with these additional properties:
 /// * The header of each file is a stand-alone gzip stream
@@ -52,6 +67,9 @@ struct OffsetDescriptor {
 /// Additionally, since the gzip standard allows concatenating streams, the file
 /// produced is still a valid '.tar.gz' file that can be opened by any program
 /// that supports "ordinary" '.tar.gz' files.
+///
+/// Since the files are compressed independently, appending many of them at
+/// once compresses them in parallel, while producing the very same output.
 class GzipTarWriter {
 private:
   llvm::raw_ostream *OS = nullptr;
@@ -67,8 +85,35 @@ public:
   GzipTarWriter(GzipTarWriter &&Other) = default;
   GzipTarWriter &operator=(GzipTarWriter &&Other) = default;
 
-  OffsetDescriptor append(llvm::StringRef Name, llvm::ArrayRef<char> Data);
-  void close();
+  OffsetDescriptor append(llvm::StringRef Name, llvm::ArrayRef<char> Data) {
+    ArchiveMember Member = { .Name = Name, .Data = Data };
+    return append(llvm::ArrayRef<ArchiveMember>(Member), 1).front();
+  }
+
+  /// Like append, but the data is provided as an already compressed,
+  /// stand-alone gzip stream of \p Size bytes, such as the data of a file of
+  /// another archive produced by this class.
+  OffsetDescriptor appendCompressed(llvm::StringRef Name,
+                                    size_t Size,
+                                    llvm::ArrayRef<char> CompressedData) {
+    ArchiveMember Member = { .Name = Name,
+                             .Data = CompressedData,
+                             .UncompressedSize = Size };
+    return append(llvm::ArrayRef<ArchiveMember>(Member), 1).front();
+  }
+
+  /// Appends \p Members in order, compressing them on up to \p ThreadsCount
+  /// threads, 0 meaning one per hardware thread.
+  ///
+  /// \return the OffsetDescriptor of each of \p Members
+  std::vector<OffsetDescriptor> append(llvm::ArrayRef<ArchiveMember> Members,
+                                       unsigned ThreadsCount = 0);
+
+  /// Ends the archive. If \p Comment is not empty, it is stored, uncompressed,
+  /// in the header of the gzip stream ending the archive.
+  ///
+  /// \return the offset of \p Comment in the archive
+  size_t close(llvm::StringRef Comment = "");
 };
 
 struct ArchiveEntry {
@@ -95,4 +140,11 @@ public:
   cppcoro::generator<ArchiveEntry> entries();
 };
 
+/// Decompresses the data of files of an archive produced by GzipTarWriter,
+/// each provided as its own gzip stream (see OffsetDescriptor::DataStart), on
+/// up to \p ThreadsCount threads, 0 meaning one per hardware thread.
+std::vector<std::string> inflateMembers(llvm::ArrayRef<llvm::ArrayRef<char>>
+                                          Members,
+                                        unsigned ThreadsCount = 0);
+
 } // namespace revng
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
 
@@ -429,6 +431,7 @@ inline constexpr llvm::StringRef getLLVMCPUFeatures(Values Type) {
 class MetaAddress : private PlainMetaAddress {
 private:
   friend class ProgramCounterHandler;
+  friend struct llvm::DenseMapInfo<MetaAddress>;
 
 public:
   constexpr static llvm::StringRef Separator = ":";
@@ -978,3 +981,38 @@ public:
   }
 };
 } // namespace std
+
+namespace llvm {
+
+/// Allows to use MetaAddress as a key of DenseMap and DenseSet
+///
+/// The empty and tombstone keys are invalid MetaAddresses with a non-zero
+/// address, which cannot be obtained through the public interface.
+template<>
+struct DenseMapInfo<MetaAddress> {
+  static MetaAddress getEmptyKey() { return createSpecial(~uint64_t(0)); }
+
+  static MetaAddress getTombstoneKey() {
+    return createSpecial(~uint64_t(0) - 1);
+  }
+
+  static unsigned getHashValue(const MetaAddress &Value) {
+    return hash_combine(Value.Epoch,
+                        Value.AddressSpace,
+                        Value.Type,
+                        Value.Address);
+  }
+
+  static bool isEqual(const MetaAddress &LHS, const MetaAddress &RHS) {
+    return LHS == RHS;
+  }
+
+private:
+  static MetaAddress createSpecial(uint64_t Address) {
+    MetaAddress Result;
+    Result.Address = Address;
+    return Result;
+  }
+};
+
+} // namespace llvm
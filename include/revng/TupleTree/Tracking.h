@@ -13,9 +13,9 @@
 /// The exact vectors contains the paths of all vectors that were marked as
 /// requiring being identical.
 ///
-/// We divide into read and exact vectors because when we will introduce the
-/// cold start invalidation based on the hash, the hash will be different
-/// depending if they are just read or if they are vectors required to be exact.
+/// We divide into read and exact vectors because they have different meanings,
+/// even if they are currently handled in the same way. In particular, the cold
+/// start invalidation stores the hash of both (see hashByPath).
 struct ReadFields {
   std::set<TupleTreePath> Read;
   std::set<TupleTreePath> ExactVectors;
@@ -38,6 +38,11 @@ struct Tracking {
 
   template<typename M>
   static void stop(const M &LHS);
+
+  /// Records a read of each field and each container of \p LHS, so that any
+  /// change to it will be reported by collect
+  template<typename M>
+  static void markAllRead(const M &LHS);
 };
 
 } // namespace revng
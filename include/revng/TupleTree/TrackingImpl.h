@@ -8,6 +8,7 @@
 #include <tuple>
 
 #include "revng/TupleTree/Tracking.h"
+#include "revng/TupleTree/TupleTreeDiff.h"
 #include "revng/TupleTree/Visits.h"
 
 namespace revng {
@@ -61,6 +62,18 @@ struct TrackingImpl {
     }
   };
 
+  struct MarkAllReadVisitor {
+    template<revng::SetOrKOC Type>
+    static void visitKeyedObjectContainer(const Type &CurrentItem) {
+      CurrentItem.markExact();
+    }
+
+    template<typename Type, size_t FieldIndex>
+    static void visitTupleElement(const Type &CurrentItem) {
+      CurrentItem.template getTracker<FieldIndex>().access();
+    }
+  };
+
   template<typename M, size_t I = 0, typename T>
   static void
   collectTuple(const T &LHS, TupleTreePath &Stack, ReadFields &Info) {
@@ -151,6 +164,68 @@ struct TrackingImpl {
 
   template<typename M, typename Visitor, NotTupleTreeCompatible T>
   static void visitImpl(const T &LHS) {}
+
+  template<typename M, size_t I = 0>
+  static void startWritesTuple(const M &Root, M &Baseline) {
+    if constexpr (I < std::tuple_size_v<M>) {
+      const auto &Field = Root.template untrackedGet<I>();
+      using FieldType = std::remove_cvref_t<decltype(Field)>;
+      if constexpr (revng::SetOrKOC<FieldType>)
+        Field.startWriteTracking();
+      else
+        get<I>(Baseline) = Field;
+
+      // Recur
+      startWritesTuple<M, I + 1>(Root, Baseline);
+    }
+  }
+
+  template<typename M, size_t I = 0>
+  static void diffWritesTuple(const M &Root,
+                              const M &Baseline,
+                              tupletreediff::detail::Diff<M> &Differ) {
+    if constexpr (I < std::tuple_size_v<M>) {
+      const auto &Field = Root.template untrackedGet<I>();
+      using FieldType = std::remove_cvref_t<decltype(Field)>;
+
+      TupleTreePath Path;
+      Path.push_back(size_t(I));
+      if constexpr (revng::SetOrKOC<FieldType>)
+        diffContainerWrites(Field, Path, Differ);
+      else
+        Differ.diff(Path, get<I>(Baseline), Field);
+
+      // Recur
+      diffWritesTuple<M, I + 1>(Root, Baseline, Differ);
+    }
+  }
+
+  template<typename M, revng::SetOrKOC T>
+  static void diffContainerWrites(const T &Container,
+                                  TupleTreePath &Path,
+                                  tupletreediff::detail::Diff<M> &Differ) {
+    auto Log = Container.stopWriteTracking();
+    if (Log.WholeContent.has_value()) {
+      Differ.diff(Path, *Log.WholeContent, Container.Content);
+      return;
+    }
+
+    // Elements are sorted by key, hence changes are emitted in the same order
+    // as a full diff would
+    for (auto &[Key, Original] : Log.Elements) {
+      auto It = Container.Content.find(Key);
+      bool Exists = It != Container.Content.end();
+      if (Original.has_value() and Exists) {
+        Path.push_back(Key);
+        Differ.diff(Path, *Original, *It);
+        Path.pop_back();
+      } else if (Original.has_value()) {
+        Differ.Result.remove(Path, *Original);
+      } else if (Exists) {
+        Differ.Result.add(Path, *It);
+      }
+    }
+  }
 };
 
 template<typename M>
@@ -183,4 +258,21 @@ void Tracking::stop(const M &LHS) {
   TrackingImpl::visitTuple<M, TrackingImpl::StopTrackingVisitor>(LHS);
 }
 
+template<typename M>
+void Tracking::markAllRead(const M &LHS) {
+  TrackingImpl::visitTuple<M, TrackingImpl::MarkAllReadVisitor>(LHS);
+}
+
 } // namespace revng
+
+template<TupleTreeRootLike M>
+void startWriteTracking(const M &Root, M &Baseline) {
+  revng::TrackingImpl::startWritesTuple(Root, Baseline);
+}
+
+template<TupleTreeRootLike M>
+TupleTreeDiff<M> diffWrites(const M &Root, const M &Baseline) {
+  tupletreediff::detail::Diff<M> Differ;
+  revng::TrackingImpl::diffWritesTuple(Root, Baseline, Differ);
+  return std::move(Differ.Result);
+}
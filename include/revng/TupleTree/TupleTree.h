@@ -9,6 +9,7 @@
 #include <optional>
 #include <set>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -235,14 +236,14 @@ public:
   void cacheReferences() {
     TrackGuard Guard(*Root);
     if (not AllReferencesAreCached)
-      visitReferencesInternal([](auto &Element) { Element.cacheTarget(); });
+      visitCachedReferences([](auto &Element) { Element.cacheTarget(); });
     AllReferencesAreCached = true;
   }
 
   void evictCachedReferences() {
     TrackGuard Guard(*Root);
     if (AllReferencesAreCached)
-      visitReferencesInternal([](auto &E) { E.evictCachedTarget(); });
+      visitCachedReferences([](auto &E) { E.evictCachedTarget(); });
     AllReferencesAreCached = false;
   }
 
@@ -283,6 +284,21 @@ private:
     visit(Visitor, [](auto &) {});
   }
 
+  /// Visit the references to update their cached target
+  ///
+  /// The cached target is not part of the value of a reference, hence the tree
+  /// is visited through the const accessors, which do not record writes.
+  template<typename L>
+  void visitCachedReferences(L &&InnerVisitor) {
+    auto Visitor = [&InnerVisitor](const auto &Element) {
+      using type = std::remove_cvref_t<decltype(Element)>;
+      if constexpr (StrictSpecializationOf<type, TupleTreeReference>)
+        std::invoke(std::forward<L>(InnerVisitor), const_cast<type &>(Element));
+    };
+
+    std::as_const(*this).visit(Visitor, [](const auto &) {});
+  }
+
 public:
   template<typename L>
   void visitReferences(L &&InnerVisitor) {
@@ -313,6 +313,14 @@ struct Diff {
     return Result;
   }
 
+  /// Diff two subtrees located at \p Path, appending the changes to Result
+  template<typename T>
+  void diff(const TupleTreePath &Path, const T &LHS, const T &RHS) {
+    Stack = Path;
+    diffImpl(LHS, RHS);
+    Stack = TupleTreePath();
+  }
+
 private:
   template<size_t I = 0, typename T>
   void diffTuple(const T &LHS, const T &RHS) {
@@ -381,6 +389,29 @@ TupleTreeDiff<M> diff(const M &LHS, const M &RHS) {
   return tupletreediff::detail::Diff<M>().diff(LHS, RHS);
 }
 
+//
+// Write tracking
+//
+
+/// Start recording the modifications performed on \p Root.
+///
+/// The top-level keyed object containers of \p Root save the original value of
+/// the elements that get modified, while the other top-level fields are copied
+/// into \p Baseline, which is expected to be default-constructed.
+///
+/// Sessions can be nested, and must be terminated in reverse order through
+/// diffWrites.
+template<TupleTreeRootLike M>
+void startWriteTracking(const M &Root, M &Baseline);
+
+/// Terminate the innermost write tracking session on \p Root.
+///
+/// The result is the same as `diff(Before, Root)`, where Before is a copy of
+/// \p Root taken when the session started, but only the subtrees that have been
+/// modified since then are inspected.
+template<TupleTreeRootLike M>
+TupleTreeDiff<M> diffWrites(const M &Root, const M &Baseline);
+
 //
 // TupleTreeDiff::dump
 //
@@ -0,0 +1,86 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "llvm/Support/xxhash.h"
+
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/ADT/UpcastablePointer.h"
+#include "revng/Support/YAMLTraits.h"
+#include "revng/TupleTree/TupleTreeCompatible.h"
+#include "revng/TupleTree/TupleTreePath.h"
+#include "revng/TupleTree/Visits.h"
+
+namespace tupletree::detail {
+
+/// Hashes the part of the object pointed by a path that, if modified, would
+/// lead a diff to report a change on that very same path: the value of fields
+/// that are not tuple trees and the set of keys of containers.
+///
+/// The content of nested objects is not taken into account, since changes to
+/// it are reported on their own paths.
+struct ShallowHashVisitor {
+  uint64_t Result = 0;
+
+  template<typename T, size_t I, typename K>
+  void visitTupleElement(K &Element) {
+    Result = hash(Element);
+  }
+
+  template<typename T, typename K, typename KeyT>
+  void visitContainerElement(KeyT, K &Element) {
+    Result = hash(Element);
+  }
+
+private:
+  template<KeyedObjectContainer T>
+  static uint64_t hash(const T &Container) {
+    using KOT = KeyedObjectTraits<typename T::value_type>;
+    std::string Keys;
+    for (const auto &Element : Container) {
+      Keys += getNameFromYAMLScalar(KOT::key(Element));
+      Keys += '\n';
+    }
+    return llvm::xxHash64(Keys);
+  }
+
+  template<TupleLike T>
+  static uint64_t hash(const T &) {
+    return 1;
+  }
+
+  // Changing the type of the pointee is reported on the pointer itself, be
+  // conservative and consider its entire content
+  template<UpcastablePointerLike T>
+  static uint64_t hash(const T &Pointer) {
+    return llvm::xxHash64(serializeToString(Pointer));
+  }
+
+  template<NotTupleTreeCompatible T>
+  static uint64_t hash(const T &Value) {
+    return llvm::xxHash64(serializeToString(Value));
+  }
+};
+
+} // namespace tupletree::detail
+
+/// Computes a hash of the object pointed by \p Path that changes whenever a
+/// diff would report a change on \p Path itself. This allows to tell whether
+/// something that depends on a given path is still up to date without keeping
+/// a copy of the tree.
+///
+/// \return std::nullopt if \p Path does not exist in \p Root
+template<TupleSizeCompatible RootT>
+std::optional<uint64_t> hashByPath(const RootT &Root,
+                                   const TupleTreePath &Path) {
+  tupletree::detail::ShallowHashVisitor Visitor;
+  if (Path.size() == 0 or not callByPath(Visitor, Path, Root))
+    return std::nullopt;
+  return Visitor.Result;
+}
@@ -55,17 +55,6 @@ private:
   template<TupleTreeCompatible>
   friend class TupleTree;
 
-  T *getCached() {
-    if (std::holds_alternative<RootT *>(Root)) {
-      revng_assert(std::holds_alternative<T *>(CachedTarget));
-      return std::get<T *>(CachedTarget);
-    } else if (std::holds_alternative<const RootT *>(Root)) {
-      revng_abort("Called getCached() with const Root, use getCachedConst!");
-    } else {
-      revng_abort("Invalid root variant!");
-    }
-  }
-
   const T *getCachedConst() const {
     const auto GetConstPtrVisitor = [](const auto &Cached) -> const T * {
       return Cached;
@@ -75,16 +64,11 @@ private:
 
   bool isCached() const { return getCachedConst() != nullptr; }
 
+  /// \note the target is resolved through the const accessors: caching is not
+  ///       a write, and the cached pointer is only handed out as const.
   bool cacheTarget() {
-    if (isValid()) {
-      if (std::holds_alternative<const RootT *>(Root)) {
-        CachedTarget = getConst();
-      } else if (std::holds_alternative<RootT *>(Root)) {
-        CachedTarget = get();
-      } else {
-        revng_abort("Invalid root variant!");
-      }
-    }
+    if (isValid())
+      CachedTarget = getByPath<const T>(Path, *getRoot());
     return isCached();
   }
 
@@ -150,12 +134,11 @@ public:
     return std::visit(GetByPathVisitor, Root);
   }
 
+  /// \note this never uses the cached target: resolving through the mutable
+  ///       accessors records the target as written if write tracking is active.
   T *get() {
     revng_assert(canGet());
 
-    if (isCached())
-      return getCached();
-
     if (Path.size() == 0)
       return nullptr;
 
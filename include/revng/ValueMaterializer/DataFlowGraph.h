@@ -90,6 +90,10 @@ public:
     Limits(unsigned MaxPhiLike, unsigned MaxLoad) :
       MaxPhiLike(MaxPhiLike), MaxLoad(MaxLoad) {}
 
+  public:
+    unsigned maxPhiLike() const { return MaxPhiLike; }
+    unsigned maxLoad() const { return MaxLoad; }
+
   public:
     bool consumePhiLike() {
       if (MaxPhiLike == 0)
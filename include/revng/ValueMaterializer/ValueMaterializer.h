@@ -5,12 +5,21 @@
 //
 
 #include <map>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Support/GenericDomTree.h"
 
 #include "revng/ADT/ConstantRangeSet.h"
 #include "revng/MFP/MFP.h"
+#include "revng/Support/Assert.h"
 #include "revng/Support/Statistics.h"
 #include "revng/ValueMaterializer/AdvancedValueInfo.h"
 #include "revng/ValueMaterializer/ControlFlowEdgesGraph.h"
@@ -31,9 +40,142 @@ enum Values {
 };
 } // namespace Oracle
 
+/// Fast path for Oracle::AdvancedValueInfo
+///
+/// Bounded jump tables are guarded by a condition on the index that dominates
+/// the indirect jump. Such conditions can be collected walking the dominator
+/// tree, which is much cheaper than running AdvancedValueInfo. If the
+/// constraints obtained this way are not enough to materialize the values, we
+/// fall back to AdvancedValueInfo.
+namespace FastPath {
+enum Values {
+  Disabled,
+  Enabled,
+  /// Always run AdvancedValueInfo and report discrepancies in the results
+  Verify
+};
+} // namespace FastPath
+
 inline RunningStatistics DFGSizeStatitistics("vm-dfg-size");
+inline CounterMap<std::string> DFGCacheStatistics("vm-dfg-cache");
+inline CounterMap<std::string> FastPathStatistics("vm-fast-path");
+inline RunningStatistics FingerprintTimeStatistics("vm-fingerprint-time-us");
+inline RunningStatistics CacheKeyTimeStatistics("vm-cache-key-time-us");
+
+/// Hashes of the code of a function which depend on the code itself, but not
+/// on the address of the objects representing it. This enables the comparison
+/// of different clones of the same function.
+///
+/// All the blocks are hashed upfront, after that the object is only read and
+/// can be shared by queries running concurrently.
+class FunctionFingerprint {
+private:
+  const llvm::Function *F = nullptr;
+  llvm::DenseMap<const llvm::BasicBlock *, std::string> BlockIDs;
+  llvm::DenseMap<const llvm::Instruction *, unsigned> Indices;
+  llvm::DenseMap<const llvm::Instruction *, uint64_t> InstructionHashes;
+  llvm::DenseMap<const llvm::BasicBlock *, uint64_t> BlockHashes;
+
+public:
+  explicit FunctionFingerprint(const llvm::Function &F);
+
+public:
+  const llvm::Function &function() const { return *F; }
+
+  /// \return an identifier of \p BB which is unique within its function: its
+  ///         name or, if it has none, its position among the unnamed blocks
+  llvm::StringRef blockID(const llvm::BasicBlock *BB) const;
+
+  /// \return the position of \p I within its block
+  unsigned index(const llvm::Instruction *I) const;
+
+  llvm::hash_code value(const llvm::Value *V) const;
+
+  uint64_t instruction(const llvm::Instruction *I) const;
+
+  uint64_t block(const llvm::BasicBlock *BB) const;
+
+private:
+  llvm::hash_code hashInstruction(const llvm::Instruction *I) const;
+};
+
+/// Memo table for the results of ValueMaterializer across analysis rounds
+///
+/// Each entry is keyed by the position of the query in the function and by a
+/// fingerprint of the data-flow graph and of the code the oracle considers.
+/// Each round hashes the code of the function once, keys are then computed
+/// combining those hashes. A round only retains the entries it used or
+/// produced, therefore entries that have been invalidated do not pile up.
+class ValueMaterializerCache {
+public:
+  struct Key {
+    std::string Position;
+    uint64_t Fingerprint = 0;
+
+    bool operator<(const Key &Other) const {
+      return std::tie(Position, Fingerprint)
+             < std::tie(Other.Position, Other.Fingerprint);
+    }
+  };
+
+private:
+  using ResultsMap = std::map<Key, std::optional<MaterializedValues>>;
+
+private:
+  ResultsMap Previous;
+  ResultsMap Current;
+  std::optional<FunctionFingerprint> Fingerprint;
+
+public:
+  /// Hash the code of \p F, which must not change until endRound() is called
+  void beginRound(const llvm::Function &F);
+
+  const FunctionFingerprint &fingerprint() const {
+    revng_assert(Fingerprint.has_value());
+    return *Fingerprint;
+  }
+
+  /// \return the results for \p TheKey, or nullptr if they are not available
+  const std::optional<MaterializedValues> *lookup(const Key &TheKey) {
+    auto It = Current.find(TheKey);
+    if (It != Current.end())
+      return &It->second;
+
+    auto PreviousIt = Previous.find(TheKey);
+    if (PreviousIt == Previous.end())
+      return nullptr;
+
+    // Retain the entry for the next round
+    auto &Result = Current[TheKey];
+    Result = std::move(PreviousIt->second);
+    Previous.erase(PreviousIt);
+    return &Result;
+  }
+
+  void insert(Key TheKey, std::optional<MaterializedValues> Values) {
+    Current[std::move(TheKey)] = std::move(Values);
+  }
+
+  /// Drop all the entries that have not been used since the last call
+  void endRound() {
+    Previous = std::move(Current);
+    Current.clear();
+    Fingerprint.reset();
+  }
+};
 
 class ValueMaterializer {
+public:
+  /// A request to materialize the values of V in Context
+  struct Query {
+    llvm::Instruction *Context = nullptr;
+    llvm::Value *V = nullptr;
+    DataFlowGraph::Limits TheLimits;
+    Oracle::Values Oracle = Oracle::AdvancedValueInfo;
+    ValueMaterializerCache *Cache = nullptr;
+    FastPath::Values FastPath = FastPath::Disabled;
+  };
+
 private:
   using ConstraintsMap = std::map<llvm::Instruction *, ConstantRangeSet>;
 
@@ -48,6 +190,8 @@ private:
   const llvm::DominatorTree &DT;
   DataFlowGraph::Limits TheLimits;
   Oracle::Values Oracle;
+  ValueMaterializerCache *Cache;
+  FastPath::Values FastPath;
 
   //
   // Outputs
@@ -60,6 +204,14 @@ private:
   std::optional<MaterializedValues> Values;
   ControlFlowEdgesGraph CFEG;
 
+  //
+  // State
+  //
+  std::optional<ValueMaterializerCache::Key> CacheKey;
+  double CacheKeyTime = 0.0;
+  bool FromCache = false;
+  bool UsingFastPath = false;
+
 private:
   ValueMaterializer(llvm::Instruction *Context,
                     llvm::Value *V,
@@ -67,28 +219,59 @@ private:
                     llvm::LazyValueInfo &LVI,
                     const llvm::DominatorTree &DT,
                     DataFlowGraph::Limits TheLimits,
-                    Oracle::Values Oracle) :
+                    Oracle::Values Oracle,
+                    ValueMaterializerCache *Cache,
+                    FastPath::Values FastPath) :
     Context(Context),
     V(V),
     MO(MO),
     LVI(LVI),
     DT(DT),
     TheLimits(TheLimits),
-    Oracle(Oracle) {}
+    Oracle(Oracle),
+    Cache(Cache),
+    FastPath(FastPath) {}
 
 public:
-  static ValueMaterializer getValuesFor(llvm::Instruction *Context,
-                                        llvm::Value *V,
-                                        MemoryOracle &MO,
-                                        llvm::LazyValueInfo &LVI,
-                                        const llvm::DominatorTree &DT,
-                                        DataFlowGraph::Limits TheLimits,
-                                        Oracle::Values Oracle) {
-    ValueMaterializer Result(Context, V, MO, LVI, DT, TheLimits, Oracle);
+  /// \param Cache if not nullptr, the memo table to reuse results from
+  ///        previous rounds. Note that, in case of a hit, only values() and
+  ///        dataFlowGraph() are available.
+  static ValueMaterializer
+  getValuesFor(llvm::Instruction *Context,
+               llvm::Value *V,
+               MemoryOracle &MO,
+               llvm::LazyValueInfo &LVI,
+               const llvm::DominatorTree &DT,
+               DataFlowGraph::Limits TheLimits,
+               Oracle::Values Oracle,
+               ValueMaterializerCache *Cache = nullptr,
+               FastPath::Values FastPath = FastPath::Disabled) {
+    ValueMaterializer Result(Context,
+                             V,
+                             MO,
+                             LVI,
+                             DT,
+                             TheLimits,
+                             Oracle,
+                             Cache,
+                             FastPath);
     Result.run();
     return Result;
   }
 
+  /// Process several queries at once, running concurrently the parts of the
+  /// analysis that only read the IR
+  ///
+  /// LazyValueInfo is not thread-safe and materialization creates constants,
+  /// therefore those parts are run sequentially.
+  ///
+  /// \return the results, in the same order as \p Queries
+  static std::vector<ValueMaterializer>
+  getValuesFor(llvm::ArrayRef<Query> Queries,
+               MemoryOracle &MO,
+               llvm::LazyValueInfo &LVI,
+               const llvm::DominatorTree &DT);
+
 public:
   const auto &dataFlowGraph() const { return DataFlowGraph; }
   const auto &oracleConstraints() const { return OracleConstraints; }
@@ -99,8 +282,44 @@ public:
 private:
   void run();
 
+  /// \name Stages of the analysis
+  ///
+  /// The stages marked as thread-safe can run concurrently on different
+  /// instances.
+  ///
+  /// @{
+
+  /// Build and simplify the data-flow graph. Thread-safe.
+  void prepare();
+
+  /// \return true if the results have been obtained from the cache
+  bool fetchFromCache();
+
+  /// Elect the nodes to materialize, using the oracle constraints.
+  /// Thread-safe.
+  void analyze();
+
+  void materialize();
+
+  /// @}
+
+  ValueMaterializerCache::Key computeCacheKey() const;
+
   void computeOracleConstraints();
 
+  void runAdvancedValueInfo();
+
+  /// Collect the constraints imposed by the conditional branches dominating
+  /// the context on the instructions of the data-flow graph
+  ///
+  /// \return true if at least a constraint has been found
+  bool computeDominatingConstraints();
+
+  void materializeUsingFastPath();
+
+  /// Drop all the results of the oracle and of the analysis
+  void resetAnalysis();
+
   void applyOracleResultsToDataFlowGraph();
 
   void computeSizeLowerBound();
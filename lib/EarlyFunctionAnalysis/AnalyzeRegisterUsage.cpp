@@ -28,10 +28,10 @@
 
 using namespace llvm;
 
-static Logger<> Log("rua-analyses");
-
 namespace efa {
 
+Logger<> RUALog("rua-analyses");
+
 template void RUAResults::dump<Logger<true>>(Logger<true> &,
                                              const char *) const;
 
@@ -236,16 +236,16 @@ RUAResults analyzeRegisterUsage(Function *F,
   RUAResults FinalResults;
 
   // TODO: can we avoid recreating this each time?
-  revng_log(Log, "Building graph for " << F->getName());
+  revng_log(RUALog, "Building graph for " << F->getName());
   auto Function = fromLLVMFunction(*F,
                                    Architecture,
                                    PreCallSiteHook,
                                    PostCallSiteHook,
                                    RetHook);
 
-  if (Log.isEnabled()) {
-    Function.Function.dump(Log);
-    Log << DoLog;
+  if (RUALog.isEnabled()) {
+    Function.Function.dump(RUALog);
+    RUALog << DoLog;
   }
 
   auto GetRegisterName = model::Register::getRegisterName;
@@ -260,7 +260,7 @@ RUAResults analyzeRegisterUsage(Function *F,
 
   {
     // Run the liveness analysis
-    revng_log(Log, "Running Liveness");
+    revng_log(RUALog, "Running Liveness");
     rua::Liveness Liveness(Function.Function);
     auto AnalysisResult = MFP::getMaximalFixedPoint(Liveness,
                                                     &Function.Function,
@@ -269,13 +269,13 @@ RUAResults analyzeRegisterUsage(Function *F,
                                                     { Function.ReturnNode });
 
     // Collect registers alive at the entry
-    revng_log(Log, "Registers alive at the entry of the function:");
+    revng_log(RUALog, "Registers alive at the entry of the function:");
     rua::BlockNode *EntryNode = Function.Function.getEntryNode();
-    const BitVector &EntryResult = AnalysisResult[EntryNode].OutValue;
+    const rua::RegisterSet &EntryResult = AnalysisResult[EntryNode].OutValue;
     for (auto Register : Function.Function.registersInSet(EntryResult)) {
       // This register is alive at the entry of the function
 
-      revng_log(Log, "  " << GetRegisterName(Register));
+      revng_log(RUALog, "  " << GetRegisterName(Register));
       FinalResults.ArgumentsRegisters.insert(GetCSV(Register));
     }
 
@@ -284,15 +284,15 @@ RUAResults analyzeRegisterUsage(Function *F,
       ResultsCallSite.CalleeAddress = CallSite.Callee;
 
       auto *PostNode = CallSite.Block;
-      revng_log(Log,
+      revng_log(RUALog,
                 "Registers alive after the call to "
                   << CallSite.Callee.toString() << " at " << PC.toString()
                   << " (block " << PostNode->label() << ")");
-      const BitVector &CallSiteResult = AnalysisResult.at(PostNode).InValue;
+      const auto &CallSiteResult = AnalysisResult.at(PostNode).InValue;
       for (auto Register : Function.Function.registersInSet(CallSiteResult)) {
         // This register is alive after the call site
 
-        revng_log(Log, "  " << GetRegisterName(Register));
+        revng_log(RUALog, "  " << GetRegisterName(Register));
         ResultsCallSite.ReturnValuesRegisters.insert(GetCSV(Register));
       }
     }
@@ -300,7 +300,7 @@ RUAResults analyzeRegisterUsage(Function *F,
 
   {
     // Run the reaching definitions analysis
-    revng_log(Log, "Running ReachingDefinitions");
+    revng_log(RUALog, "Running ReachingDefinitions");
     rua::ReachingDefinitions ReachingDefinitions(Function.Function);
     auto DefaultValue = ReachingDefinitions.defaultValue();
     auto *EntryNode = Function.Function.getEntryNode();
@@ -321,7 +321,7 @@ RUAResults analyzeRegisterUsage(Function *F,
       return rua::ReachingDefinitions::compute(*NodeResults, SinkResults);
     };
 
-    revng_log(Log,
+    revng_log(RUALog,
               "Registers with at least one write that reaches the exit node of "
               "the function without ever being read:");
     rua::BlockNode *ExitNode = Function.ReturnNode;
@@ -329,7 +329,7 @@ RUAResults analyzeRegisterUsage(Function *F,
     for (auto Register : Function.Function.registersInSet(ExitResult)) {
       // This register has at least one write that reaches the exit node of the
       // function without ever being read
-      revng_log(Log, "  " << GetRegisterName(Register));
+      revng_log(RUALog, "  " << GetRegisterName(Register));
 
       FinalResults.ReturnValuesRegisters.insert(GetCSV(Register));
     }
@@ -337,7 +337,7 @@ RUAResults analyzeRegisterUsage(Function *F,
     for (const auto &[PC, CallSite] : Function.CallSites) {
       auto &ResultsCallSite = FinalResults.CallSites[PC];
       ResultsCallSite.CalleeAddress = CallSite.Callee;
-      revng_log(Log,
+      revng_log(RUALog,
                 "Registers with at least one write that reaches the call to "
                   << CallSite.Callee.toString() << " at " << PC.toString()
                   << " without ever being read:");
@@ -348,7 +348,7 @@ RUAResults analyzeRegisterUsage(Function *F,
         // This register has at least one write that reaches the call site
         // without ever being read
 
-        revng_log(Log, "  " << GetRegisterName(Register));
+        revng_log(RUALog, "  " << GetRegisterName(Register));
 
         ResultsCallSite.ArgumentsRegisters.insert(GetCSV(Register));
       }
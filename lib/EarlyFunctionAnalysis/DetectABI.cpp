@@ -6,7 +6,9 @@
 
 #include <fstream>
 #include <iterator>
+#include <list>
 #include <memory>
+#include <optional>
 
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -17,11 +19,15 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/GraphWriter.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/ABI/Definition.h"
 #include "revng/ABI/FunctionType/Layout.h"
+#include "revng/ADT/BatchedFixedPoint.h"
 #include "revng/ADT/Queue.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/EarlyFunctionAnalysis/AnalyzeRegisterUsage.h"
 #include "revng/EarlyFunctionAnalysis/CFGAnalyzer.h"
 #include "revng/EarlyFunctionAnalysis/CallEdge.h"
 #include "revng/EarlyFunctionAnalysis/CallGraph.h"
@@ -53,6 +59,13 @@ static opt<std::string> CallGraphOutputPath("cg-output",
                                                  "call graph."),
                                             value_desc("filename"));
 
+static opt<unsigned> DetectABIThreads("detect-abi-threads",
+                                       desc("Number of threads analyzing "
+                                            "functions concurrently during "
+                                            "ABI detection, 0 means one per "
+                                            "core."),
+                                       init(0));
+
 enum ABIEnforcementOption {
   NoABIEnforcement = 0,
   SoftABIEnforcement,
@@ -82,6 +95,13 @@ static opt<ABIOpt> ABIEnforcement("abi-enforcement-level",
                                                     "found.")),
                                   init(ABIOpt::FullABIEnforcement));
 
+static opt<unsigned> MaxOutlinedFunctions("detect-abi-max-outlined-functions",
+                                           desc("Maximum number of outlined "
+                                                "functions to keep in memory "
+                                                "during the ABI analysis, 0 "
+                                                "means no limit."),
+                                           init(1024));
+
 static Logger<> Log("detect-abi");
 
 struct Changes {
@@ -89,6 +109,13 @@ struct Changes {
   std::set<MetaAddress> Callees;
 };
 
+/// The results of the register usage analyses on a function, before they are
+/// committed to the oracle
+struct RegisterUsage {
+  efa::CSVSet WrittenRegisters;
+  efa::RUAResults ABIResults;
+};
+
 class DetectABIAnalysis {
 private:
   template<typename... T>
@@ -135,6 +162,61 @@ static bool isWritingToMemory(llvm::Instruction &I) {
 
 using BasicBlockQueue = UniquedQueue<const BasicBlockNode *>;
 
+/// Keeps in memory at most a given number of outlined functions, outlining
+/// them on demand and dropping the least recently used ones
+class OutlinedFunctionsCache {
+private:
+  using Entry = std::pair<MetaAddress, OutlinedFunction>;
+  using EntryIterator = std::list<Entry>::iterator;
+
+private:
+  CFGAnalyzer &Analyzer;
+  GeneratedCodeBasicInfo &GCBI;
+
+  /// 0 means no limit
+  size_t Capacity = 0;
+
+  /// The most recently used entry comes first
+  std::list<Entry> Entries;
+  std::map<MetaAddress, EntryIterator> Index;
+
+public:
+  OutlinedFunctionsCache(CFGAnalyzer &Analyzer,
+                         GeneratedCodeBasicInfo &GCBI,
+                         size_t Capacity) :
+    Analyzer(Analyzer), GCBI(GCBI), Capacity(Capacity) {}
+
+public:
+  size_t capacity() const { return Capacity; }
+
+  /// \return the outlined function starting at \p Address, which stays valid
+  ///         until `capacity()` other functions have been requested
+  OutlinedFunction &get(MetaAddress Address) {
+    auto It = Index.find(Address);
+    if (It != Index.end()) {
+      Entries.splice(Entries.begin(), Entries, It->second);
+      return Entries.front().second;
+    }
+
+    // Outlining only depends on the CFG of the functions and on the
+    // information collected by preliminaryFunctionAnalysis, which do not
+    // change anymore: outlining again an evicted function gives the same
+    // result
+    llvm::BasicBlock *EntryBlock = GCBI.getBlockAt(Address);
+    Entries.emplace_front(Address, Analyzer.outline(EntryBlock));
+    Index[Address] = Entries.begin();
+
+    if (Capacity != 0) {
+      while (Entries.size() > Capacity) {
+        Index.erase(Entries.back().first);
+        Entries.pop_back();
+      }
+    }
+
+    return Entries.front().second;
+  }
+};
+
 class DetectABI {
 private:
   using BasicBlockToNodeMap = llvm::DenseMap<llvm::BasicBlock *,
@@ -203,9 +285,13 @@ private:
   void computeApproximateCallGraph();
   void preliminaryFunctionAnalysis();
   void analyzeABI();
-  Changes analyzeFunctionABI(const model::Function &Function,
-                             OutlinedFunction &OutlinedFunction,
-                             OpaqueRegisterUser &Clobberer);
+
+  /// Inject in \p OutlinedFunction the reads of the arguments and the writes
+  /// of the return values of the callees, according to the oracle
+  void enrichCallSites(const model::Function &Function,
+                       OutlinedFunction &OutlinedFunction,
+                       OpaqueRegisterUser &RegisterReader);
+
   void applyABIDeductions();
 
   /// Finish the population of the model by building the prototype
@@ -225,10 +311,16 @@ private:
   TrackingSortedVector<model::Register::Values>
   computePreservedRegisters(const CSVSet &ClobberedRegisters) const;
 
-  Changes runAnalyses(MetaAddress EntryAddress,
-                      OutlinedFunction &OutlinedFunction);
+  /// Run the register usage analyses on \p OutlinedFunction
+  ///
+  /// Neither the IR nor the oracle are modified, therefore this can run on
+  /// distinct functions concurrently.
+  RegisterUsage runAnalyses(OutlinedFunction &OutlinedFunction) const;
 
-  CSVSet findWrittenRegisters(llvm::Function *F);
+  /// Merge \p Usage into the summary of \p EntryAddress and of its callees
+  Changes commitAnalyses(MetaAddress EntryAddress, RegisterUsage &&Usage);
+
+  CSVSet findWrittenRegisters(llvm::Function *F) const;
 
   UpcastablePointer<model::Type>
   buildPrototypeForIndirectCall(const FunctionSummary &CallerSummary,
@@ -448,22 +540,41 @@ void DetectABI::analyzeABI() {
   revng_log(Log, "Running ABI analyses");
   LoggerIndent<> Indent(Log);
 
-  llvm::Task Task(2, "analyzeABI");
-  std::map<MetaAddress, std::unique_ptr<OutlinedFunction>> Functions;
+  // Temporary functions are created the first time they are needed
+  OutlinedFunctionsCache Functions(Analyzer, GCBI, MaxOutlinedFunctions);
+
+  // For each function, the functions whose summary might be read or updated
+  // while analyzing it: the function itself and its callees, both according to
+  // the outlined function and to the approximate call graph
+  std::map<MetaAddress, std::set<MetaAddress>> Footprints;
+  auto GetFootprint = [&](MetaAddress Entry) -> const std::set<MetaAddress> & {
+    auto It = Footprints.find(Entry);
+    if (It != Footprints.end())
+      return It->second;
+
+    std::set<MetaAddress> &Footprint = Footprints[Entry];
+    Footprint.insert(Entry);
+
+    OutlinedFunction &OutlinedFunction = Functions.get(Entry);
+    for (Instruction &I : instructions(OutlinedFunction.Function.get())) {
+      if (CallInst *Call = getCallTo(&I, Analyzer.preCallHook())) {
+        auto Callee = MetaAddress::fromValue(Call->getArgOperand(1));
+        if (Callee.isValid())
+          Footprint.insert(Callee);
+      }
+    }
 
-  // Create all temporary functions
-  Task.advance("Create temporary functions");
-  for (model::Function &Function : Binary->Functions()) {
-    llvm::BasicBlock *Entry = GCBI.getBlockAt(Function.Entry());
-    auto NewFunction = make_unique<OutlinedFunction>(Analyzer.outline(Entry));
-    Functions[Function.Entry()] = std::move(NewFunction);
-  }
+    auto *Node = BasicBlockNodeMap[GCBI.getBlockAt(Entry)];
+    for (auto *Callee : Node->successors())
+      Footprint.insert(Callee->Address);
+
+    return Footprint;
+  };
 
   // Push this into analyzeFunction
   OpaqueRegisterUser RegisterUser(&M);
 
   // TODO: this really needs to become a monotone framework
-  Task.advance("Run fixed-point analyses");
   llvm::Task FixedPointTask({}, "Fixed-point analysis");
   UniquedQueue<model::Function *> ToAnalyze;
   for (model::Function &Function : Binary->Functions())
@@ -477,48 +588,86 @@ void DetectABI::analyzeABI() {
     Oracle.setDefault(std::move(NewDefault));
   }
 
-  unsigned Runs = 0;
-  while (not ToAnalyze.empty()) {
-    model::Function &Function = *ToAnalyze.pop();
-    revng_log(Log, "Analyzing " << Function.Entry().toString());
-    FixedPointTask.advance(Function.name());
-    OutlinedFunction &OutlinedFunction = *Functions.at(Function.Entry());
-    Changes Changes = analyzeFunctionABI(Function,
-                                         OutlinedFunction,
-                                         RegisterUser);
-
-    if (Changes.Function) {
-      revng_log(Log, "The function has changed, re-enqueing all callers:");
-      LoggerIndent<> Indent(Log);
-      // The prototype of the function we analyzed has changed, reanalyze
-      // callers
-      auto &FunctionNode = BasicBlockNodeMap[GCBI.getBlockAt(Function.Entry())];
-      for (auto &CallerNode : FunctionNode->predecessors()) {
-        if (CallerNode->Address.isValid()) {
-          revng_log(Log, CallerNode->Address.toString());
-          ToAnalyze.insert(&Binary->Functions().at(CallerNode->Address));
+  // Go sequential if there's nothing to gain or if we need readable logs
+  auto Strategy = llvm::hardware_concurrency(DetectABIThreads);
+  std::optional<llvm::ThreadPool> Pool;
+  if (Strategy.compute_thread_count() > 1 and not Log.isEnabled()
+      and not RUALog.isEnabled()) {
+    Pool.emplace(Strategy);
+  }
+  size_t MaxBatchSize = 1;
+  if (Pool.has_value())
+    MaxBatchSize = 4 * Strategy.compute_thread_count();
+
+  // All the members of a batch need to be in memory at the same time
+  if (Functions.capacity() != 0)
+    MaxBatchSize = std::min(MaxBatchSize, Functions.capacity());
+
+  auto GetFunctionFootprint = [&](model::Function *Function) -> const auto & {
+    return GetFootprint(Function->Entry());
+  };
+
+  auto Prepare = [&](model::Function *Function) -> OutlinedFunction * {
+    revng_log(Log, "Analyzing " << Function->Entry().toString());
+    FixedPointTask.advance(Function->name());
+    OutlinedFunction &OutlinedFunction = Functions.get(Function->Entry());
+    enrichCallSites(*Function, OutlinedFunction, RegisterUser);
+    return &OutlinedFunction;
+  };
+
+  auto Analyze = [this](OutlinedFunction *OutlinedFunction) {
+    return runAnalyses(*OutlinedFunction);
+  };
+
+  auto Commit = [&](ArrayRef<model::Function *> Batch,
+                    MutableArrayRef<RegisterUsage> Results) {
+    RegisterUser.purgeCreated();
+
+    for (size_t Index = 0; Index < Batch.size(); ++Index) {
+      model::Function &Function = *Batch[Index];
+      Changes Changes = commitAnalyses(Function.Entry(),
+                                       std::move(Results[Index]));
+
+      if (Changes.Function) {
+        revng_log(Log, "The function has changed, re-enqueing all callers:");
+        LoggerIndent<> Indent(Log);
+        // The prototype of the function we analyzed has changed, reanalyze
+        // callers
+        auto *Entry = GCBI.getBlockAt(Function.Entry());
+        auto &FunctionNode = BasicBlockNodeMap[Entry];
+        for (auto &CallerNode : FunctionNode->predecessors()) {
+          if (CallerNode->Address.isValid()) {
+            revng_log(Log, CallerNode->Address.toString());
+            ToAnalyze.insert(&Binary->Functions().at(CallerNode->Address));
+          }
         }
       }
-    }
 
-    // Register for re-analysis all the callees for which we have new
-    // information
-    for (const MetaAddress &ToReanalyze : Changes.Callees) {
-      revng_assert(ToReanalyze.isValid());
-      revng_log(Log, "Re-enqueing callee " << ToReanalyze.toString());
-      ToAnalyze.insert(&Binary->Functions().at(ToReanalyze));
+      // Register for re-analysis all the callees for which we have new
+      // information
+      for (const MetaAddress &ToReanalyze : Changes.Callees) {
+        revng_assert(ToReanalyze.isValid());
+        revng_log(Log, "Re-enqueing callee " << ToReanalyze.toString());
+        ToAnalyze.insert(&Binary->Functions().at(ToReanalyze));
+      }
     }
-  }
-}
+  };
 
-Changes DetectABI::analyzeFunctionABI(const model::Function &Function,
-                                      OutlinedFunction &OutlinedFunction,
-                                      OpaqueRegisterUser &RegisterReader) {
-  revng_log(Log, "Analyzing the ABI of " << Function.Entry().toString());
+  // The oracle is only updated in queue order once the whole batch has been
+  // analyzed, hence the results do not depend on the number of threads
+  runBatchedFixedPoint(ToAnalyze,
+                       Pool.has_value() ? &*Pool : nullptr,
+                       MaxBatchSize,
+                       GetFunctionFootprint,
+                       Prepare,
+                       Analyze,
+                       Commit);
+}
 
-  //
-  // Enrich all the call sites
-  //
+void DetectABI::enrichCallSites(const model::Function &Function,
+                                OutlinedFunction &OutlinedFunction,
+                                OpaqueRegisterUser &RegisterReader) {
+  revng_log(Log, "Enriching the call sites of " << Function.Entry().toString());
 
   // Collect all calls to precall_hook and postcall_hook
   SmallVector<std::pair<CallInst *, bool>> Hooks;
@@ -568,13 +717,6 @@ Changes DetectABI::analyzeFunctionABI(const model::Function &Function,
       }
     }
   }
-
-  // Perform the analysis
-  Changes Changes = runAnalyses(Function.Entry(), OutlinedFunction);
-
-  RegisterReader.purgeCreated();
-
-  return Changes;
 }
 
 // TODO: drop this.
@@ -908,7 +1050,7 @@ bool DetectABI::getRegisterState(model::Register::Values RegisterValue,
   return false;
 }
 
-CSVSet DetectABI::findWrittenRegisters(llvm::Function *F) {
+CSVSet DetectABI::findWrittenRegisters(llvm::Function *F) const {
   using namespace llvm;
 
   CSVSet WrittenRegisters;
@@ -991,25 +1133,29 @@ static auto zeroOrOne(const T &Range, const F &Predicate)
   return Result;
 }
 
-Changes DetectABI::runAnalyses(MetaAddress EntryAddress,
-                               OutlinedFunction &OutlinedFunction) {
-  using namespace llvm;
-  using llvm::BasicBlock;
-
-  IRBuilder<> Builder(M.getContext());
-  RUAResults ABIResults;
+RegisterUsage DetectABI::runAnalyses(OutlinedFunction &OutlinedFunction) const {
+  RegisterUsage Result;
 
   // Find registers that may be target of at least one store. This helps
   // refine the final results.
-  auto WrittenRegisters = findWrittenRegisters(OutlinedFunction.Function.get());
+  llvm::Function *F = OutlinedFunction.Function.get();
+  Result.WrittenRegisters = findWrittenRegisters(F);
 
   // Run ABI-independent data-flow analyses
-  ABIResults = analyzeRegisterUsage(OutlinedFunction.Function.get(),
-                                    GCBI,
-                                    Binary->Architecture(),
-                                    Analyzer.preCallHook(),
-                                    Analyzer.postCallHook(),
-                                    Analyzer.retHook());
+  Result.ABIResults = analyzeRegisterUsage(F,
+                                           GCBI,
+                                           Binary->Architecture(),
+                                           Analyzer.preCallHook(),
+                                           Analyzer.postCallHook(),
+                                           Analyzer.retHook());
+
+  return Result;
+}
+
+Changes DetectABI::commitAnalyses(MetaAddress EntryAddress,
+                                  RegisterUsage &&Usage) {
+  RUAResults &ABIResults = Usage.ABIResults;
+  CSVSet &WrittenRegisters = Usage.WrittenRegisters;
 
   // We say that a register is callee-saved when, besides being preserved by
   // the callee, there is at least a write onto this register.
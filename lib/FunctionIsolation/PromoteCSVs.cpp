@@ -29,6 +29,7 @@ static Register X("promote-csvs", "Promote CSVs Pass", true, true);
 
 struct PromoteCSVsPipe {
   static constexpr auto Name = "promote-csvs";
+  static constexpr bool IsFunctionLocal = true;
 
   std::vector<pipeline::ContractGroup> getContract() const {
     using namespace pipeline;
@@ -17,7 +17,10 @@
 #include <vector>
 
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/DiagnosticPrinter.h"
@@ -29,9 +32,14 @@
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/Progress.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_os_ostream.h"
+#include "llvm/Support/xxhash.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils.h"
@@ -49,6 +57,7 @@
 #include "revng/Support/Debug.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/ProgramCounterHandler.h"
+#include "revng/Support/ResourceFinder.h"
 
 #include "CodeGenerator.h"
 #include "ExternalJumpsHandler.h"
@@ -67,8 +76,16 @@ static cl::opt<bool> RecordPTC("record-ptc",
                                cl::desc("create metadata for PTC"),
                                cl::cat(MainCategory));
 
+static cl::opt<bool> HelpersCache("helpers-cache",
+                                  cl::desc("cache the prepared QEMU helpers "
+                                           "module in $XDG_CACHE_HOME/revng "
+                                           "(~/.cache/revng if unset)"),
+                                  cl::cat(MainCategory),
+                                  cl::init(false));
+
 static Logger<> PTCLog("ptc");
 static Logger<> Log("lift");
+static Logger<> HelpersCacheLog("helpers-cache");
 
 template<typename T, typename... ArgTypes>
 inline std::array<T, sizeof...(ArgTypes)> make_array(ArgTypes &&...Args) {
@@ -145,6 +162,9 @@ static std::unique_ptr<Module> parseIR(StringRef Path, LLVMContext &Context) {
   return Result;
 }
 
+static std::unique_ptr<Module> loadHelpers(StringRef Path,
+                                           LLVMContext &Context);
+
 CodeGenerator::CodeGenerator(const RawBinaryView &RawBinary,
                              llvm::Module *TheModule,
                              const TupleTree<model::Binary> &Model,
@@ -160,27 +180,10 @@ CodeGenerator::CodeGenerator(const RawBinaryView &RawBinary,
   OriginalInstrMDKind = Context.getMDKindID("oi");
   PTCInstrMDKind = Context.getMDKindID("pi");
 
-  HelpersModule = parseIR(Helpers, Context);
+  HelpersModule = loadHelpers(Helpers, Context);
 
   TheModule->setDataLayout(HelpersModule->getDataLayout());
 
-  // Tag all global objects in HelpersModule as QEMU
-  for (GlobalVariable &G : HelpersModule->globals())
-    FunctionTags::QEMU.addTo(&G);
-
-  for (Function &F : HelpersModule->functions()) {
-    if (F.isIntrinsic())
-      continue;
-
-    F.setDSOLocal(false);
-
-    FunctionTags::QEMU.addTo(&F);
-
-    if (F.hasFnAttribute(Attribute::NoReturn)
-        or F.getSection() == "revng_exceptional")
-      FunctionTags::Exceptional.addTo(&F);
-  }
-
   EarlyLinkedModule = parseIR(EarlyLinked, Context);
   for (llvm::Function &F : *EarlyLinkedModule) {
     if (F.isIntrinsic())
@@ -584,39 +587,40 @@ bool CpuLoopExitPass::runOnModule(llvm::Module &M) {
   return true;
 }
 
-void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
-  using FT = FunctionType;
+/// Bump whenever prepareHelpers changes, so that cached helpers modules
+/// produced by previous versions are not used, even by development builds
+/// sharing the same commit
+static constexpr uint64_t HelpersCacheVersion = 1;
 
-  Task T(12, "Translation");
+/// Prepares the QEMU helpers module for being linked in the lifted module
+static void prepareHelpers(Module &Helpers) {
+  // Tag all global objects in Helpers as QEMU
+  for (GlobalVariable &G : Helpers.globals())
+    FunctionTags::QEMU.addTo(&G);
 
-  // Declare the abort function
-  auto *AbortTy = FunctionType::get(Type::getVoidTy(Context), false);
-  FunctionCallee AbortFunction = TheModule->getOrInsertFunction("abort",
-                                                                AbortTy);
-  {
-    auto *Abort = cast<Function>(skipCasts(AbortFunction.getCallee()));
-    FunctionTags::Exceptional.addTo(Abort);
+  for (Function &F : Helpers.functions()) {
+    if (F.isIntrinsic())
+      continue;
+
+    F.setDSOLocal(false);
+
+    FunctionTags::QEMU.addTo(&F);
+
+    if (F.hasFnAttribute(Attribute::NoReturn)
+        or F.getSection() == "revng_exceptional")
+      FunctionTags::Exceptional.addTo(&F);
   }
 
   // Prepare the helper modules by transforming the cpu_loop function and
   // running SROA
-  T.advance("Prepare helpers module", true);
   legacy::PassManager CpuLoopPM;
   CpuLoopPM.add(new LoopInfoWrapperPass());
   CpuLoopPM.add(new CpuLoopFunctionPass(ptc.exception_index));
   CpuLoopPM.add(createSROAPass());
-  CpuLoopPM.run(*HelpersModule);
+  CpuLoopPM.run(Helpers);
 
   // Drop the main
-  eraseFromParent(HelpersModule->getFunction("main"));
-
-  // From syscall.c
-  new GlobalVariable(*TheModule,
-                     Type::getInt32Ty(Context),
-                     false,
-                     GlobalValue::CommonLinkage,
-                     ConstantInt::get(Type::getInt32Ty(Context), 0),
-                     StringRef("do_strace"));
+  eraseFromParent(Helpers.getFunction("main"));
 
   //
   // Handle some specific QEMU functions as no-ops or abort
@@ -639,7 +643,7 @@ void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
                                                     "qemu_thread_atexit_init",
                                                     "start_exclusive");
   for (auto Name : NoOpFunctionNames)
-    replaceFunctionWithRet(HelpersModule->getFunction(Name), 0);
+    replaceFunctionWithRet(Helpers.getFunction(Name), 0);
 
   // Transform in abort
 
@@ -658,18 +662,157 @@ void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
                                                      "do_arm_semihosting",
                                                      "EmulateAll");
   for (auto Name : AbortFunctionNames) {
-    Function *TheFunction = HelpersModule->getFunction(Name);
+    Function *TheFunction = Helpers.getFunction(Name);
     if (TheFunction != nullptr) {
-      revng_assert(HelpersModule->getFunction("abort") != nullptr);
+      revng_assert(Helpers.getFunction("abort") != nullptr);
       BasicBlock *NewBody = replaceFunction(TheFunction);
-      CallInst::Create(HelpersModule->getFunction("abort"), {}, NewBody);
-      new UnreachableInst(Context, NewBody);
+      CallInst::Create(Helpers.getFunction("abort"), {}, NewBody);
+      new UnreachableInst(Helpers.getContext(), NewBody);
     }
   }
 
-  replaceFunctionWithRet(HelpersModule->getFunction("page_check_range"), 1);
-  replaceFunctionWithRet(HelpersModule->getFunction("page_get_flags"),
+  replaceFunctionWithRet(Helpers.getFunction("page_check_range"), 1);
+  replaceFunctionWithRet(Helpers.getFunction("page_get_flags"),
                          0xffffffff);
+}
+
+/// \return the path of the cached version of the helpers module in \p Path,
+///         whose content is \p Buffer
+static std::string getHelpersCachePath(StringRef Path, StringRef Buffer) {
+  SmallString<128> Result;
+  if (auto XDGCacheHome = sys::Process::GetEnv("XDG_CACHE_HOME")) {
+    sys::path::append(Result, *XDGCacheHome);
+  } else {
+    sys::path::home_directory(Result);
+    sys::path::append(Result, ".cache");
+  }
+
+  // The prepared module depends on the helpers themselves, on the libtinycode
+  // in use, on the build of revng and LLVM preparing it and on the tags it
+  // attaches
+  std::string ComponentsHash = revng::getComponentsHash();
+  std::string Key = (Twine(HelpersCacheVersion) + ":" + ComponentsHash + ":"
+                     + LLVM_VERSION_STRING + ":" + FunctionTags::QEMU.name()
+                     + ":" + FunctionTags::Exceptional.name() + ":"
+                     + Twine(ptc.exception_index) + ":"
+                     + Twine(xxHash64(Buffer)))
+                      .str();
+  std::string FileName = (sys::path::stem(Path) + "-"
+                          + utohexstr(xxHash64(Key)) + ".bc")
+                           .str();
+  sys::path::append(Result, "revng", "lift-helpers", FileName);
+  return Result.str().str();
+}
+
+static void storeHelpersCache(const Module &Helpers, StringRef CachePath) {
+  StringRef Directory = sys::path::parent_path(CachePath);
+  if (std::error_code EC = sys::fs::create_directories(Directory)) {
+    revng_log(HelpersCacheLog,
+              "Cannot create " << Directory.str() << ": " << EC.message());
+    return;
+  }
+
+  // Write to a temporary file first, so that concurrent runs never see a
+  // partially written module
+  int FD = -1;
+  SmallString<128> TemporaryPath;
+  if (std::error_code EC = sys::fs::createUniqueFile(CachePath + "-%%%%%%.tmp",
+                                                     FD,
+                                                     TemporaryPath)) {
+    revng_log(HelpersCacheLog,
+              "Cannot create a temporary file: " << EC.message());
+    return;
+  }
+
+  {
+    raw_fd_ostream OS(FD, true);
+    WriteBitcodeToFile(Helpers, OS);
+    OS.close();
+    if (OS.has_error()) {
+      revng_log(HelpersCacheLog,
+                "Cannot write " << TemporaryPath.str().str() << ": "
+                                << OS.error().message());
+      OS.clear_error();
+      sys::fs::remove(TemporaryPath);
+      return;
+    }
+  }
+
+  if (std::error_code EC = sys::fs::rename(TemporaryPath, CachePath)) {
+    revng_log(HelpersCacheLog,
+              "Cannot move " << TemporaryPath.str().str() << " to "
+                             << CachePath.str() << ": " << EC.message());
+    sys::fs::remove(TemporaryPath);
+  }
+}
+
+/// Loads the helpers module in \p Path and prepares it through
+/// prepareHelpers, or loads the result of a previous run from the cache.
+static std::unique_ptr<Module> loadHelpers(StringRef Path,
+                                           LLVMContext &Context) {
+  if (not HelpersCache) {
+    std::unique_ptr<Module> Result = parseIR(Path, Context);
+    prepareHelpers(*Result);
+    return Result;
+  }
+
+  auto MaybeBuffer = MemoryBuffer::getFile(Path);
+  revng_assert(MaybeBuffer, "Cannot read the helpers module");
+  std::string CachePath = getHelpersCachePath(Path,
+                                              MaybeBuffer.get()->getBuffer());
+
+  if (sys::fs::exists(CachePath)) {
+    // Function bodies are materialized only as they are needed
+    SMDiagnostic Errors;
+    auto Result = getLazyIRFileModule(CachePath, Errors, Context);
+    if (Result != nullptr) {
+      revng_log(HelpersCacheLog, "Using " << CachePath);
+      return Result;
+    }
+
+    revng_log(HelpersCacheLog,
+              "Cannot load " << CachePath << ": "
+                             << Errors.getMessage().str());
+  }
+
+  SMDiagnostic Errors;
+  auto Result = llvm::parseIR(MaybeBuffer.get()->getMemBufferRef(),
+                              Errors,
+                              Context);
+  if (Result == nullptr) {
+    Errors.print("revng", dbgs());
+    revng_abort();
+  }
+
+  prepareHelpers(*Result);
+
+  revng_log(HelpersCacheLog, "Storing " << CachePath);
+  storeHelpersCache(*Result, CachePath);
+
+  return Result;
+}
+
+void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
+  using FT = FunctionType;
+
+  Task T(11, "Translation");
+
+  // Declare the abort function
+  auto *AbortTy = FunctionType::get(Type::getVoidTy(Context), false);
+  FunctionCallee AbortFunction = TheModule->getOrInsertFunction("abort",
+                                                                AbortTy);
+  {
+    auto *Abort = cast<Function>(skipCasts(AbortFunction.getCallee()));
+    FunctionTags::Exceptional.addTo(Abort);
+  }
+
+  // From syscall.c
+  new GlobalVariable(*TheModule,
+                     Type::getInt32Ty(Context),
+                     false,
+                     GlobalValue::CommonLinkage,
+                     ConstantInt::get(Type::getInt32Ty(Context), 0),
+                     StringRef("do_strace"));
 
   //
   // Record globals for marking them as internal after linking
@@ -9,8 +9,12 @@
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/Local.h"
 
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/Statistics.h"
 
 #include "JumpTargetManager.h"
@@ -26,6 +30,14 @@ Logger<> RegisterJTLog("registerjt");
 
 CounterMap<std::string> HarvestingStats("harvesting");
 
+cl::opt<bool> IncrementalHarvest("incremental-harvest",
+                                 cl::desc("when harvesting jump targets, only "
+                                          "optimize the code translated since "
+                                          "the last round, as long as new "
+                                          "jump targets are found"),
+                                 cl::cat(MainCategory),
+                                 cl::init(true));
+
 RegisterPass<TranslateDirectBranchesPass> X("translate-db",
                                             "Translate Direct Branches"
                                             " Pass",
@@ -49,8 +61,11 @@ static void exitTBCleanup(Instruction *ExitTBCall) {
 
 using TDBP = TranslateDirectBranchesPass;
 
-TDBP::TranslateDirectBranchesPass(JumpTargetManager *J) :
-  ModulePass(ID), JTM(J), PCH(J->programCounterHandler()) {
+TDBP::TranslateDirectBranchesPass(JumpTargetManager *J, bool OnlyNewCode) :
+  ModulePass(ID),
+  JTM(J),
+  PCH(J->programCounterHandler()),
+  OnlyNewCode(OnlyNewCode) {
 }
 
 using DispatcherTargets = ProgramCounterHandler::DispatcherTargets;
@@ -133,6 +148,12 @@ bool TDBP::pinMaterializedValues(Function &F) {
         continue;
 
       auto *MD = Call->getMetadata("revng.targets");
+
+      // Pinning again the same targets has no effect
+      if (OnlyNewCode and MD != nullptr
+          and Call->getMetadata("revng.pinned-targets") == MD)
+        continue;
+
       if (auto *T = dyn_cast_or_null<MDTuple>(MD)) {
         // Compute the list of MetaAddress/symbols destinations
         SmallVector<llvm::StringRef> SymbolDestinations;
@@ -164,25 +185,27 @@ bool TDBP::pinMaterializedValues(Function &F) {
           for (const auto &Address : DirectDestinations)
             Values.emplace_back(Address, JTM->getBlockAt(Address));
           pinExitTB(Call, Values);
+          Call->setMetadata("revng.pinned-targets", T);
         } else if (HasOneSymbolDestination) {
           // Jump to a symbol
 
-          auto *T = Call->getParent()->getTerminator();
-          revng_assert(hasMarker(T, Call->getCalledFunction()));
+          auto *Terminator = Call->getParent()->getTerminator();
+          revng_assert(hasMarker(Terminator, Call->getCalledFunction()));
 
           // Purge existing marker, if any
-          if (CallInst *Marker = getMarker(T, JumpToSymbolMarker))
+          if (CallInst *Marker = getMarker(Terminator, JumpToSymbolMarker))
             Marker->eraseFromParent();
 
           // Create the marker
           StringRef SymbolName = SymbolDestinations[0];
-          // TODO: in theory we could insert this before T, not Call, but it's
-          //       violating some assumption somewhere
+          // TODO: in theory we could insert this before Terminator, not Call,
+          //       but it's violating some assumption somewhere
           CallInst::Create({ JumpToSymbolMarker },
                            { getUniqueString(M, SymbolName) },
                            {},
                            "",
                            Call);
+          Call->setMetadata("revng.pinned-targets", T);
         }
       }
     }
@@ -237,6 +260,10 @@ bool TDBP::pinConstantStore(Function &F) {
     auto *Call = cast<CallInst>(ExitTBUse.getUser());
     revng_assert(Call->getCalledFunction() == ExitTB);
 
+    // New code cannot turn an indirect jump into a direct one
+    if (OnlyNewCode and JTM->isHarvested(Call->getParent()))
+      continue;
+
     // Look for the last write to the PC
     auto [Result, NextPC] = PCH->getUniqueJumpTarget(Call->getParent());
 
@@ -462,6 +489,106 @@ JumpTargetManager::JumpTargetManager(Function *TheFunction,
   // getOption<uint32_t>(Options, "max-recurse-depth")->setInitialValue(10);
 }
 
+namespace {
+
+/// An aligned word in a segment that might be a pointer to code
+struct CodePointerCandidate {
+  uint64_t Offset;
+  uint64_t Value;
+};
+
+/// A portion of a segment to scan for code pointers, and its results
+struct CodePointersScan {
+  MetaAddress SegmentStart;
+  const unsigned char *Start;
+  const unsigned char *End;
+  uint64_t StartOffset;
+  std::vector<CodePointerCandidate> Candidates;
+};
+
+/// Sorted, disjoint, non-empty [Start, End) ranges of raw addresses
+using RawRanges = std::vector<std::pair<uint64_t, uint64_t>>;
+
+} // namespace
+
+/// \return true if \p Value might be a pointer to one of \p Ranges, either as
+///         it is or, as it happens for Thumb code, once its LSB is cleared
+static bool mightPointTo(const RawRanges &Ranges, uint64_t Value) {
+  using Range = std::pair<uint64_t, uint64_t>;
+  auto CompareStart = [](uint64_t Value, const Range &R) {
+    return Value < R.first;
+  };
+  auto It = std::upper_bound(Ranges.begin(), Ranges.end(), Value, CompareStart);
+  if (It == Ranges.begin())
+    return false;
+  --It;
+  return (Value & ~uint64_t(1)) < It->second;
+}
+
+/// Collects the aligned words of \p Scan that might point to \p Ranges.
+///
+/// Most words in data are nowhere near the code. Therefore the words are
+/// checked in blocks against the bounds of all the ranges, through a
+/// branch-free loop that compilers vectorize, and only the blocks with words
+/// within the bounds are looked up in \p Ranges.
+template<typename value_type, support::endianness Endianness>
+static void scanCodePointers(const RawRanges &Ranges, CodePointersScan &Scan) {
+  using support::endian::read;
+  constexpr size_t Step = sizeof(value_type);
+  constexpr size_t BlockSize = 64;
+  const uint64_t Low = Ranges.front().first;
+  const uint64_t High = Ranges.back().second;
+
+  auto Check = [&](const unsigned char *Cursor) {
+    uint64_t Value = read<value_type, Endianness, 1>(Cursor);
+    if (mightPointTo(Ranges, Value)) {
+      uint64_t Offset = Scan.StartOffset + (Cursor - Scan.Start);
+      Scan.Candidates.push_back({ Offset, Value });
+    }
+  };
+
+  const unsigned char *Cursor = Scan.Start;
+  size_t Words = (Scan.End - Scan.Start) / Step;
+  const unsigned char *BlocksEnd = Cursor + (Words - Words % BlockSize) * Step;
+  for (; Cursor < BlocksEnd; Cursor += BlockSize * Step) {
+    bool AnyInBounds = false;
+    for (size_t I = 0; I < BlockSize; ++I) {
+      uint64_t Value = read<value_type, Endianness, 1>(Cursor + I * Step);
+      AnyInBounds |= (Value >= Low) & ((Value & ~uint64_t(1)) < High);
+    }
+
+    if (AnyInBounds)
+      for (size_t I = 0; I < BlockSize; ++I)
+        Check(Cursor + I * Step);
+  }
+
+  for (; Cursor < Scan.End; Cursor += Step)
+    Check(Cursor);
+}
+
+/// Number of words scanned by each task, so that large segments are scanned in
+/// parallel too
+static constexpr size_t ScanChunkWords = 1 << 20;
+
+template<typename value_type, support::endianness Endianness>
+static void scanCodePointers(const RawRanges &Ranges,
+                             llvm::MutableArrayRef<CodePointersScan> Scans) {
+  auto Strategy = llvm::hardware_concurrency();
+  if (Scans.size() <= 1 or Strategy.compute_thread_count() <= 1) {
+    for (CodePointersScan &Scan : Scans)
+      scanCodePointers<value_type, Endianness>(Ranges, Scan);
+    return;
+  }
+
+  llvm::ThreadPool Pool(Strategy);
+  for (CodePointersScan &Scan : Scans) {
+    Pool.async([&Ranges, &Scan]() {
+      scanCodePointers<value_type, Endianness>(Ranges, Scan);
+    });
+  }
+  Pool.wait();
+}
+
 void JumpTargetManager::harvestGlobalData() {
   // Register symbols
   for (const model::Function &Function : Model->Functions())
@@ -471,70 +598,91 @@ void JumpTargetManager::harvestGlobalData() {
   for (MetaAddress Address : Model->ExtraCodeAddresses())
     registerJT(Address, JTReason::GlobalData);
 
+  // Collect the executable ranges as plain integers
+  RawRanges Ranges;
+  for (const auto &[Start, End] : ExecutableRanges)
+    if (Start.address() < End.address())
+      Ranges.emplace_back(Start.address(), End.address());
+  llvm::sort(Ranges);
+
+  RawRanges Merged;
+  for (const auto &Range : Ranges) {
+    if (not Merged.empty() and Range.first <= Merged.back().second)
+      Merged.back().second = std::max(Merged.back().second, Range.second);
+    else
+      Merged.push_back(Range);
+  }
+
+  using namespace model::Architecture;
+  bool IsLittleEndian = isLittleEndian(Model->Architecture());
+  auto PointerSize = getPointerSize(Model->Architecture());
+  revng_assert(PointerSize == 8 or PointerSize == 4);
+
+  // Split the segments in chunks of aligned words
+  std::vector<CodePointersScan> Scans;
   for (auto &[Segment, Data] : BinaryView.segments()) {
     MetaAddress StartVirtualAddress = Segment.StartAddress();
     const unsigned char *DataStart = Data.begin();
     const unsigned char *DataEnd = Data.end();
 
-    using namespace model::Architecture;
-    bool IsLittleEndian = isLittleEndian(Model->Architecture());
-    auto PointerSize = getPointerSize(Model->Architecture());
-    using endianness = support::endianness;
-    if (PointerSize == 8) {
-      if (IsLittleEndian)
-        findCodePointers<uint64_t, endianness::little>(StartVirtualAddress,
-                                                       DataStart,
-                                                       DataEnd);
-      else
-        findCodePointers<uint64_t, endianness::big>(StartVirtualAddress,
-                                                    DataStart,
-                                                    DataEnd);
-    } else if (PointerSize == 4) {
-      if (IsLittleEndian)
-        findCodePointers<uint32_t, endianness::little>(StartVirtualAddress,
-                                                       DataStart,
-                                                       DataEnd);
-      else
-        findCodePointers<uint32_t, endianness::big>(StartVirtualAddress,
-                                                    DataStart,
-                                                    DataEnd);
+    if (Merged.empty() or DataEnd - DataStart <= PointerSize)
+      continue;
+
+    // Align the starting address: we want to scan one step at a time starting
+    // from an aligned size
+    const unsigned char *Cursor = DataStart;
+    auto Misalignment = StartVirtualAddress.address() % PointerSize;
+    if (Misalignment != 0)
+      Cursor += PointerSize - Misalignment;
+
+    // The last word is never considered
+    const unsigned char *End = DataEnd - PointerSize;
+    while (Cursor < End) {
+      size_t Remaining = (End - Cursor + PointerSize - 1) / PointerSize;
+      size_t Words = std::min(Remaining, ScanChunkWords);
+      const unsigned char *ChunkEnd = std::min(End,
+                                               Cursor + Words * PointerSize);
+      Scans.push_back({ .SegmentStart = StartVirtualAddress,
+                        .Start = Cursor,
+                        .End = ChunkEnd,
+                        .StartOffset = static_cast<uint64_t>(Cursor
+                                                             - DataStart),
+                        .Candidates = {} });
+      Cursor = ChunkEnd;
     }
   }
 
-  revng_log(JTCountLog,
-            "JumpTargets found in global data: " << std::dec
-                                                 << Unexplored.size());
-}
-
-template<typename value_type, unsigned endian>
-void JumpTargetManager::findCodePointers(MetaAddress StartVirtualAddress,
-                                         const unsigned char *Start,
-                                         const unsigned char *End) {
-  using support::endianness;
-  using support::endian::read;
-
-  constexpr auto Step = sizeof(value_type);
-
-  auto Cursor = Start;
-
-  // Align the starting address: we want to scan one step at a time starting
-  // from an aligned size
-  auto Misalignment = StartVirtualAddress.address() % Step;
-  if (Misalignment != 0)
-    Cursor += Step - Misalignment;
+  using endianness = support::endianness;
+  if (PointerSize == 8) {
+    if (IsLittleEndian)
+      scanCodePointers<uint64_t, endianness::little>(Merged, Scans);
+    else
+      scanCodePointers<uint64_t, endianness::big>(Merged, Scans);
+  } else {
+    if (IsLittleEndian)
+      scanCodePointers<uint32_t, endianness::little>(Merged, Scans);
+    else
+      scanCodePointers<uint32_t, endianness::big>(Merged, Scans);
+  }
 
-  for (; Cursor < End - Step; Cursor += Step) {
-    auto Read = read<value_type, static_cast<endianness>(endian), 1>;
-    uint64_t RawValue = Read(Cursor);
-    MetaAddress Value = fromPC(RawValue);
-    if (Value.isInvalid())
-      continue;
+  // Register the candidates in order, so that the results do not depend on how
+  // the scan has been split
+  for (const CodePointersScan &Scan : Scans) {
+    for (const CodePointerCandidate &Candidate : Scan.Candidates) {
+      MetaAddress Value = fromPC(Candidate.Value);
+      if (Value.isInvalid())
+        continue;
 
-    BasicBlock *Result = registerJT(Value, JTReason::GlobalData);
+      BasicBlock *Result = registerJT(Value, JTReason::GlobalData);
 
-    if (Result != nullptr)
-      UnusedCodePointers.insert(StartVirtualAddress + (Cursor - Start));
+      if (Result != nullptr)
+        UnusedCodePointers.insert(Scan.SegmentStart + Candidate.Offset);
+    }
   }
+
+  revng_log(JTCountLog,
+            "JumpTargets found in global data: " << std::dec
+                                                 << Unexplored.size());
 }
 
 /// Handle a new program counter. We might already have a basic block for that
@@ -556,25 +704,18 @@ BasicBlock *JumpTargetManager::newPC(MetaAddress PC, bool &ShouldContinue) {
   auto JTIt = JumpTargets.find(PC);
   if (JTIt != JumpTargets.end()) {
     // If it was planned to explore it in the future, just to do it now
-    for (auto UnexploredIt = Unexplored.begin();
-         UnexploredIt != Unexplored.end();
-         UnexploredIt++) {
-
-      if (UnexploredIt->first == PC) {
-        BasicBlock *Result = UnexploredIt->second;
-
-        // Check if we already have a translation for that
-        ShouldContinue = Result->empty();
-        if (ShouldContinue) {
-          // We don't, OK let's explore it next
-          Unexplored.erase(UnexploredIt);
-        } else {
-          // We do, it will be purged at the next `peek`
-          revng_assert(ToPurge.contains(Result));
-        }
-
-        return Result;
+    if (BasicBlock *Result = Unexplored.lookup(PC)) {
+      // Check if we already have a translation for that
+      ShouldContinue = Result->empty();
+      if (ShouldContinue) {
+        // We don't, OK let's explore it next
+        Unexplored.erase(PC);
+      } else {
+        // We do, it will be purged at the next `peek`
+        revng_assert(ToPurge.count(Result) != 0);
       }
+
+      return Result;
     }
 
     // It wasn't planned to visit it, so we've already been there, just jump
@@ -797,8 +938,11 @@ JumpTargetManager::BlockWithAddress JumpTargetManager::peek() {
     revng_log(JTCountLog, "We're done looking for jump targets");
     return NoMoreTargets;
   } else {
-    BlockWithAddress Result = Unexplored.back();
-    Unexplored.pop_back();
+    BlockWithAddress Result = Unexplored.pop();
+
+    // The block is about to be filled with new code
+    HarvestedBlocks.erase(Result.second);
+
     return Result;
   }
 }
@@ -919,7 +1063,7 @@ BasicBlock *JumpTargetManager::registerJT(MetaAddress PC,
     NewBlock = BasicBlock::Create(Context, "", TheFunction);
   }
 
-  Unexplored.push_back(BlockWithAddress(PC, NewBlock));
+  Unexplored.push(PC, NewBlock);
 
   std::stringstream Name;
   Name << "bb." << nameForAddress(PC);
@@ -1090,7 +1234,9 @@ void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist) {
   // Add all the (whitelisted) jump targets if we're using the
   // SemanticPreserving, or only those with no predecessors.
   bool IsWhitelistActive = (Whitelist != nullptr);
-  for (auto &[PC, JumpTarget] : JumpTargets) {
+  auto SortedJumpTargets = sortedJumpTargets();
+  for (const BlockMap::value_type *Entry : SortedJumpTargets) {
+    const auto &[PC, JumpTarget] = *Entry;
     BasicBlock *BB = JumpTarget.head();
     bool IsWhitelisted = (not IsWhitelistActive or Whitelist->contains(PC));
     if ((CurrentCFGForm == CFGForm::SemanticPreserving
@@ -1121,14 +1267,15 @@ void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist) {
     }
 
     // Identify all the unreachable jump targets, and add an edge from the
-    // dispatcher to them. Note that the order we use to iterate over
-    // `JumpTargets` is fundamental, because we want to connect to the
+    // dispatcher to them. Note that iterating over the jump targets sorted by
+    // address is fundamental, because we want to connect to the
     // dispatcher first the jump target with the lower program counter. At the
     // same time, we will mark as reachable all the jump targets that are
     // transitively reachable from the elected jump target. In this way, we
     // connect to the dispatcher all the blocks belonging to a separate SCC that
     // were not reachable initially (e.g., a function only indirectly called).
-    for (const auto &[PC, JT] : JumpTargets) {
+    for (const BlockMap::value_type *Entry : SortedJumpTargets) {
+      const auto &[PC, JT] = *Entry;
       BasicBlock *BB = JT.head();
       bool IsWhitelisted = (not IsWhitelistActive or Whitelist->contains(PC));
 
@@ -1151,6 +1298,20 @@ void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist) {
   }
 }
 
+std::vector<const JumpTargetManager::BlockMap::value_type *>
+JumpTargetManager::sortedJumpTargets() const {
+  std::vector<const BlockMap::value_type *> Result;
+  Result.reserve(JumpTargets.size());
+  for (const BlockMap::value_type &Entry : JumpTargets)
+    Result.push_back(&Entry);
+
+  llvm::sort(Result, [](const auto *LHS, const auto *RHS) {
+    return LHS->first < RHS->first;
+  });
+
+  return Result;
+}
+
 bool JumpTargetManager::hasPredecessors(BasicBlock *BB) const {
   for (BasicBlock *Pred : predecessors(BB))
     if (isTranslatedBB(Pred))
@@ -1185,7 +1346,10 @@ void JumpTargetManager::harvest() {
     T.advance("Simple literals");
     HarvestingStats.push("harvest 1: SimpleLiterals");
     revng_log(JTCountLog, "Collecting simple literals");
-    for (MetaAddress PC : SimpleLiterals)
+    std::vector<MetaAddress> Sorted(SimpleLiterals.begin(),
+                                    SimpleLiterals.end());
+    llvm::sort(Sorted);
+    for (MetaAddress PC : Sorted)
       registerJT(PC, JTReason::SimpleLiteral);
     SimpleLiterals.clear();
   }
@@ -1194,73 +1358,116 @@ void JumpTargetManager::harvest() {
     T.advance("SROA + InstCombine + TBDP");
     HarvestingStats.push("harvest 2: SROA + InstCombine + TBDP");
 
-    // Safely erase all unreachable blocks
-    llvm::DenseSet<BasicBlock *> Unreachable = computeUnreachable();
-    for (BasicBlock *BB : Unreachable)
-      BB->dropAllReferences();
-    for (BasicBlock *BB : Unreachable)
-      eraseFromParent(BB);
-
-    // TODO: move me to a commit function
-
-    // Update the third argument of newpc calls (isJT, i.e., is this instruction
-    // a jump target?)
-    IRBuilder<> Builder(Context);
-    Function *NewPCFunction = TheModule.getFunction("newpc");
-    if (NewPCFunction != nullptr) {
-      for (User *U : NewPCFunction->users()) {
-        auto *Call = cast<CallInst>(U);
-        if (Call->getParent() != nullptr) {
-          // Report the instruction on
-          // the coverage CSV
-          MetaAddress PC = addressFromNewPC(Call);
-          bool IsJT = isJumpTarget(PC);
-          Call->setArgOperand(2, Builder.getInt32(static_cast<uint32_t>(IsJT)));
-        }
+    // Incremental rounds might miss jump targets that can only be found
+    // considering the whole root function, therefore, if they do not find
+    // anything new, confirm the fixed point has been reached with a full round
+    bool Incremental = IncrementalHarvest and not HarvestedBlocks.empty();
+    optimizeAndHarvest(Incremental);
+    if (Incremental and empty() and NewBranches == 0) {
+      HarvestingStats.push("harvest 2: full round");
+      revng_log(JTCountLog, "Nothing new found, running a full round");
+      optimizeAndHarvest(false);
+    }
+  }
+}
+
+void JumpTargetManager::optimizeAndHarvest(bool Incremental) {
+  Task T(2, Incremental ? "Incremental round" : "Full round");
+  T.advance("SROA + InstSimplify + TBDP");
+
+  // Safely erase all unreachable blocks
+  llvm::DenseSet<BasicBlock *> Unreachable = computeUnreachable();
+  for (BasicBlock *BB : Unreachable)
+    BB->dropAllReferences();
+  for (BasicBlock *BB : Unreachable) {
+    HarvestedBlocks.erase(BB);
+    eraseFromParent(BB);
+  }
+
+  // TODO: move me to a commit function
+
+  // Update the third argument of newpc calls (isJT, i.e., is this instruction
+  // a jump target?)
+  IRBuilder<> Builder(Context);
+  Function *NewPCFunction = TheModule.getFunction("newpc");
+  if (NewPCFunction != nullptr) {
+    for (User *U : NewPCFunction->users()) {
+      auto *Call = cast<CallInst>(U);
+      if (Call->getParent() != nullptr) {
+        // Report the instruction on
+        // the coverage CSV
+        MetaAddress PC = addressFromNewPC(Call);
+        bool IsJT = isJumpTarget(PC);
+        Call->setArgOperand(2, Builder.getInt32(static_cast<uint32_t>(IsJT)));
       }
     }
+  }
 
-    revng::verify(&TheModule);
+  revng::verify(&TheModule);
 
-    revng_log(JTCountLog, "Preliminary harvesting");
+  revng_log(JTCountLog, "Preliminary harvesting");
 
-    HarvestingStats.push("InstCombine");
-    legacy::FunctionPassManager OptimizingPM(&TheModule);
-    OptimizingPM.add(createSROAPass());
+  // Collect the basic blocks that have been created since the last round
+  SmallVector<BasicBlock *, 64> NewBlocks;
+  if (Incremental) {
+    for (BasicBlock &BB : *TheFunction)
+      if (not isHarvested(&BB))
+        NewBlocks.push_back(&BB);
+    revng_log(JTCountLog,
+              "Incremental round on " << NewBlocks.size() << " out of "
+                                      << TheFunction->size() << " blocks");
+  }
+
+  // SROA runs on the whole function in incremental rounds too: the temporaries
+  // of the code translated in previous rounds have already been promoted,
+  // therefore it only has work to do on the new ones
+  HarvestingStats.push("InstCombine");
+  legacy::FunctionPassManager OptimizingPM(&TheModule);
+  OptimizingPM.add(createSROAPass());
+  if (not Incremental)
     OptimizingPM.add(createInstSimplifyLegacyPass());
-    OptimizingPM.doInitialization();
-    OptimizingPM.run(*TheFunction);
-    OptimizingPM.doFinalization();
-
-    legacy::PassManager PreliminaryBranchesPM;
-    PreliminaryBranchesPM.add(new TranslateDirectBranchesPass(this));
-    PreliminaryBranchesPM.run(TheModule);
-
-    if (empty()) {
-      T.advance("Advanced Value Info");
-      HarvestingStats.push("harvest 3: cloneOptimizeAndHarvest");
-      revng_log(JTCountLog, "Harvesting with Advanced Value Info");
-      RootAnalyzer(*this).cloneOptimizeAndHarvest(TheFunction);
-    }
+  OptimizingPM.doInitialization();
+  OptimizingPM.run(*TheFunction);
+  OptimizingPM.doFinalization();
 
-    // TODO: eventually, `setCFGForm` should be replaced by using a CustomCFG
-    // To improve the quality of our analysis, keep in the CFG only the edges we
-    // where able to recover (e.g., no jumps to the dispatcher)
-    setCFGForm(CFGForm::RecoveredOnly);
+  if (Incremental)
+    for (BasicBlock *BB : NewBlocks)
+      SimplifyInstructionsInBlock(BB);
 
-    NewBranches = 0;
-    legacy::PassManager AnalysisPM;
-    AnalysisPM.add(new TranslateDirectBranchesPass(this));
-    AnalysisPM.run(TheModule);
+  legacy::PassManager PreliminaryBranchesPM;
+  PreliminaryBranchesPM.add(new TranslateDirectBranchesPass(this,
+                                                            Incremental));
+  PreliminaryBranchesPM.run(TheModule);
 
-    // Restore the CFG
-    setCFGForm(CFGForm::SemanticPreserving);
+  if (empty()) {
+    T.advance("Advanced Value Info");
+    HarvestingStats.push("harvest 3: cloneOptimizeAndHarvest");
+    revng_log(JTCountLog, "Harvesting with Advanced Value Info");
+    RootAnalyzer(*this).cloneOptimizeAndHarvest(TheFunction);
+  }
 
-    if (JTCountLog.isEnabled()) {
-      JTCountLog << std::dec << Unexplored.size() << " new jump targets and "
-                 << NewBranches << " new branches were found" << DoLog;
-    }
+  // TODO: eventually, `setCFGForm` should be replaced by using a CustomCFG
+  // To improve the quality of our analysis, keep in the CFG only the edges we
+  // where able to recover (e.g., no jumps to the dispatcher)
+  setCFGForm(CFGForm::RecoveredOnly);
+
+  NewBranches = 0;
+  legacy::PassManager AnalysisPM;
+  AnalysisPM.add(new TranslateDirectBranchesPass(this, Incremental));
+  AnalysisPM.run(TheModule);
+
+  // Restore the CFG
+  setCFGForm(CFGForm::SemanticPreserving);
+
+  if (JTCountLog.isEnabled()) {
+    JTCountLog << std::dec << Unexplored.size() << " new jump targets and "
+               << NewBranches << " new branches were found" << DoLog;
   }
+
+  // Everything in the root function has now been considered
+  HarvestedBlocks.clear();
+  for (BasicBlock &BB : *TheFunction)
+    HarvestedBlocks.try_emplace(&BB, &BB);
 }
 
 using BWA = JumpTargetManager::BlockWithAddress;
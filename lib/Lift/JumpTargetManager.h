@@ -15,9 +15,11 @@
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/Analysis/MemorySSAUpdater.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/IR/ValueHandle.h"
 
 #include "revng/BasicAnalyses/MaterializedValue.h"
 #include "revng/Lift/Lift.h"
@@ -27,6 +29,7 @@
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/ProgramCounterHandler.h"
+#include "revng/ValueMaterializer/ValueMaterializer.h"
 
 // Forward declarations
 namespace llvm {
@@ -70,9 +73,12 @@ auto containing(Map &M, typename Map::key_type const &K) {
 class TranslateDirectBranchesPass : public llvm::ModulePass {
 public:
   TranslateDirectBranchesPass() :
-    llvm::ModulePass(ID), JTM(nullptr), PCH(nullptr) {}
+    llvm::ModulePass(ID), JTM(nullptr), PCH(nullptr), OnlyNewCode(false) {}
 
-  TranslateDirectBranchesPass(JumpTargetManager *JTM);
+  /// \param OnlyNewCode if true, ignore the calls to exit_tb in basic blocks
+  ///        already considered by a previous harvesting round, unless
+  ///        ValueMaterializer provided new results for them.
+  TranslateDirectBranchesPass(JumpTargetManager *JTM, bool OnlyNewCode = false);
 
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
 
@@ -104,6 +110,7 @@ public:
 private:
   JumpTargetManager *JTM;
   ProgramCounterHandler *PCH;
+  bool OnlyNewCode;
 };
 
 namespace CFGForm {
@@ -212,7 +219,7 @@ public:
   };
 
 public:
-  using BlockMap = std::map<MetaAddress, JumpTarget>;
+  using BlockMap = llvm::DenseMap<MetaAddress, JumpTarget>;
   using RangesVector = std::vector<std::pair<MetaAddress, MetaAddress>>;
   using CSAAFactory = std::function<CPUStateAccessAnalysisPass *(void)>;
 
@@ -271,7 +278,7 @@ public:
   BlockWithAddress peek();
 
   /// Return true if no unexplored jump targets are available
-  bool empty() { return Unexplored.empty(); }
+  bool empty() const { return Unexplored.empty(); }
 
   /// Return true if the whole [\p Start,\p End) range is in an executable
   /// segment
@@ -366,10 +373,6 @@ public:
     return JumpTargets.contains(PC);
   }
 
-  BlockMap::const_iterator begin() const { return JumpTargets.begin(); }
-
-  BlockMap::const_iterator end() const { return JumpTargets.end(); }
-
   void registerJT(llvm::BasicBlock *BB, JTReason::Values Reason) {
     registerJT(getBasicBlockAddress(notNull(BB)), Reason);
   }
@@ -383,7 +386,7 @@ public:
     revng_assert(PC.isValid());
 
     if (isJumpTarget(PC)) {
-      Result = not JumpTargets.at(PC).hasReason(Reason);
+      Result = not JumpTargets.find(PC)->second.hasReason(Reason);
       registerJT(PC, Reason);
     }
 
@@ -442,6 +445,13 @@ public:
     ValueMaterializerPCWhiteList.clear();
   }
 
+  /// \return true if \p BB was already part of the root function at the end of
+  ///         the last harvesting round.
+  bool isHarvested(llvm::BasicBlock *BB) const {
+    auto It = HarvestedBlocks.find(BB);
+    return It != HarvestedBlocks.end() and It->second == BB;
+  }
+
   /// Finalizes information about the jump targets
   ///
   /// Call this function once no more jump targets can be discovered.  It will
@@ -458,7 +468,13 @@ public:
 
     using namespace model::Architecture;
     uint64_t ReadSize = getPointerSize(Model->Architecture());
-    for (MetaAddress MemoryAddress : UnusedCodePointers) {
+
+    // Visit the pointers in address order, so that the outcome does not
+    // depend on the hashing
+    std::vector<MetaAddress> SortedPointers(UnusedCodePointers.begin(),
+                                            UnusedCodePointers.end());
+    llvm::sort(SortedPointers);
+    for (MetaAddress MemoryAddress : SortedPointers) {
       // Read using the original endianness, we want the correct address
       auto MaybeRawPC = BinaryView.readInteger(MemoryAddress, ReadSize);
       MetaAddress PC = MetaAddress::invalid();
@@ -553,6 +569,8 @@ public:
 
   ProgramCounterHandler *programCounterHandler() { return PCH; }
 
+  ValueMaterializerCache &valueMaterializerCache() { return VMCache; }
+
   llvm::DenseSet<llvm::BasicBlock *> computeUnreachable() const;
 
 private:
@@ -583,19 +601,78 @@ private:
   /// to all the jump targets or only to those who have no other predecessor.
   void rebuildDispatcher(MetaAddressSet *Whitelist);
 
-  void prepareDispatcher();
+  /// \return the jump targets sorted by address
+  std::vector<const BlockMap::value_type *> sortedJumpTargets() const;
 
-  template<typename value_type, unsigned endian>
-  void findCodePointers(MetaAddress StartVirtualAddress,
-                        const unsigned char *Start,
-                        const unsigned char *End);
+  void prepareDispatcher();
 
   void harvest();
 
+  /// Optimize the root function and look for new jump targets and branches in
+  /// it
+  ///
+  /// \param Incremental if true, limit the work to the basic blocks that have
+  ///        been added since the last round.
+  void optimizeAndHarvest(bool Incremental);
+
   llvm::CallInst *getJumpTarget(llvm::BasicBlock *Target);
 
 private:
-  using InstructionMap = std::map<MetaAddress, llvm::Instruction *>;
+  using InstructionMap = llvm::DenseMap<MetaAddress, llvm::Instruction *>;
+
+  /// Stack of the jump targets that still have to be translated
+  ///
+  /// Entries are indexed by address, so that newPC can check whether a PC is
+  /// pending, and remove it, without scanning the whole stack. Entries
+  /// removed out of order are replaced by a tombstone (a null basic block).
+  class UnexploredStack {
+  private:
+    std::vector<BlockWithAddress> Entries;
+    llvm::DenseMap<MetaAddress, size_t> Index;
+
+  public:
+    bool empty() const { return Index.empty(); }
+    size_t size() const { return Index.size(); }
+
+    void push(MetaAddress PC, llvm::BasicBlock *BB) {
+      revng_assert(BB != nullptr);
+      bool New = Index.try_emplace(PC, Entries.size()).second;
+      revng_assert(New);
+      Entries.emplace_back(PC, BB);
+    }
+
+    BlockWithAddress pop() {
+      revng_assert(not empty());
+      BlockWithAddress Result = Entries.back();
+      Entries.pop_back();
+      Index.erase(Result.first);
+      dropTombstones();
+      return Result;
+    }
+
+    /// \return the basic block pending for \p PC, or nullptr if there's none
+    llvm::BasicBlock *lookup(MetaAddress PC) const {
+      auto It = Index.find(PC);
+      if (It == Index.end())
+        return nullptr;
+      return Entries[It->second].second;
+    }
+
+    void erase(MetaAddress PC) {
+      auto It = Index.find(PC);
+      revng_assert(It != Index.end());
+      Entries[It->second].second = nullptr;
+      Index.erase(It);
+      dropTombstones();
+    }
+
+  private:
+    /// Ensure the top of the stack is never a tombstone
+    void dropTombstones() {
+      while (not Entries.empty() and Entries.back().second == nullptr)
+        Entries.pop_back();
+    }
+  };
 
   llvm::Module &TheModule;
   llvm::LLVMContext &Context;
@@ -606,7 +683,7 @@ private:
   /// Holds the association between a PC and a BasicBlock.
   BlockMap JumpTargets;
   /// Queue of program counters we still have to translate.
-  std::vector<BlockWithAddress> Unexplored;
+  UnexploredStack Unexplored;
 
   llvm::Function *ExitTB;
   RangesVector ExecutableRanges;
@@ -619,17 +696,29 @@ private:
 
   unsigned NewBranches = 0;
 
-  std::set<MetaAddress> UnusedCodePointers;
+  llvm::DenseSet<MetaAddress> UnusedCodePointers;
   interval_set ReadIntervalSet;
 
   CFGForm::Values CurrentCFGForm;
-  std::set<llvm::BasicBlock *> ToPurge;
-  std::set<MetaAddress> SimpleLiterals;
+  llvm::SetVector<llvm::BasicBlock *> ToPurge;
+  llvm::DenseSet<MetaAddress> SimpleLiterals;
   CSAAFactory CreateCSAA;
 
   ProgramCounterHandler *PCH;
 
   MetaAddressSet ValueMaterializerPCWhiteList;
+
+  /// Results of ValueMaterializer, shared across harvesting rounds
+  ValueMaterializerCache VMCache;
+
+  /// Basic blocks of the root function at the end of the last harvesting
+  /// round
+  ///
+  /// Keys might be dangling pointers: a block is harvested only if its handle
+  /// is still alive, so that a new block allocated at the address of a deleted
+  /// one is not mistaken for it.
+  llvm::DenseMap<llvm::BasicBlock *, llvm::WeakVH> HarvestedBlocks;
+
   const TupleTree<model::Binary> &Model;
   const RawBinaryView &BinaryView;
 };
@@ -632,7 +632,7 @@ SummaryCallsBuilder RootAnalyzer::optimize(llvm::Function *OptimizedFunction,
     FPM.addPass(DropRangeMetadataPass());
 
     // Run ValueMaterializer!
-    FPM.addPass(ValueMaterializerPass(MO));
+    FPM.addPass(ValueMaterializerPass(MO, JTM.valueMaterializerCache()));
 
     FunctionAnalysisManager FAM;
     FAM.registerPass([]() { return TypeShrinking::BitLivenessPass(); });
@@ -21,6 +21,35 @@ using namespace llvm;
 cl::list<uint64_t> DumpValueMaterializerAt("dump-vm-at", cl::ZeroOrMore);
 cl::opt<bool> DumpValueMaterializer("dump-all-vm");
 
+static cl::opt<bool> CacheValueMaterializer("vm-cache",
+                                            cl::desc("reuse the results of "
+                                                     "ValueMaterializer from "
+                                                     "previous harvesting "
+                                                     "rounds, if the code "
+                                                     "they depend on did not "
+                                                     "change"),
+                                            cl::init(true));
+
+static cl::opt<FastPath::Values>
+  ValueMaterializerFastPath("vm-fast-path",
+                            cl::desc("how to use the fast path for bounded "
+                                     "jump tables before AdvancedValueInfo"),
+                            cl::values(clEnumValN(FastPath::Disabled,
+                                                  "disabled",
+                                                  "Always run "
+                                                  "AdvancedValueInfo."),
+                                       clEnumValN(FastPath::Enabled,
+                                                  "enabled",
+                                                  "Run AdvancedValueInfo only "
+                                                  "if the fast path fails."),
+                                       clEnumValN(FastPath::Verify,
+                                                  "verify",
+                                                  "Always run "
+                                                  "AdvancedValueInfo and "
+                                                  "compare its results with "
+                                                  "the fast path.")),
+                            cl::init(FastPath::Enabled));
+
 using SDMO = StaticDataMemoryOracle;
 
 SDMO::StaticDataMemoryOracle(const DataLayout &DL,
@@ -85,6 +114,10 @@ PreservedAnalyses ValueMaterializerPass::run(Function &F,
   auto &LVI = FAM.getResult<LazyValueAnalysis>(F);
   auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
 
+  // Hash the code once, the IR is not changed until the end of the round
+  if (CacheValueMaterializer)
+    Cache.beginRound(F);
+
   BasicBlock *Entry = &F.getEntryBlock();
   SwitchInst *Terminator = cast<SwitchInst>(Entry->getTerminator());
   BasicBlock *Dispatcher = Terminator->getDefaultDest();
@@ -93,6 +126,14 @@ PreservedAnalyses ValueMaterializerPass::run(Function &F,
     return cast<ConstantInt>(Call->getArgOperand(Index))->getLimitedValue();
   };
 
+  struct MarkerInfo {
+    CallBase *Call = nullptr;
+    MetaAddress Address;
+    bool Dump = false;
+  };
+
+  std::vector<MarkerInfo> Markers;
+  std::vector<ValueMaterializer::Query> Queries;
   for (CallBase *Call : callersIn(Marker, &F)) {
     // Decode arguments
     revng_assert(Call->arg_size() >= 4);
@@ -108,53 +149,80 @@ PreservedAnalyses ValueMaterializerPass::run(Function &F,
     revng_assert(Address.isValid());
     uint64_t CurrentAddress = Address.address();
 
-    MaterializedValues Values;
+    // Dumping requires the full results, do not use the cache
+    bool Dump = DumpValueMaterializer
+                or count(DumpValueMaterializerAt, CurrentAddress) > 0;
+    ValueMaterializerCache *CachePointer = nullptr;
+    if (CacheValueMaterializer and not Dump)
+      CachePointer = &Cache;
+
     DataFlowGraph::Limits Limits(MaxPhiLike, MaxLoad);
-    auto Results = ValueMaterializer::getValuesFor(Call,
-                                                   ToTrack,
-                                                   MO,
-                                                   LVI,
-                                                   DT,
-                                                   Limits,
-                                                   Oracle);
-    if (Results.values())
-      Values = std::move(*Results.values());
-
-    if (DumpValueMaterializer
-        or count(DumpValueMaterializerAt, CurrentAddress) > 0) {
-      // User asked to dump information about this address
-      dbg << "Values produced by ValueMaterializer for " << getName(ToTrack)
-          << " at " << Address.toString() << ":\n";
-      for (const MaterializedValue &V : Values) {
-        dbg << "  ";
-        V.dump(dbg);
-        dbg << "\n";
+    Markers.push_back({ Call, Address, Dump });
+    Queries.push_back({ Call,
+                        ToTrack,
+                        Limits,
+                        Oracle,
+                        CachePointer,
+                        ValueMaterializerFastPath });
+  }
+
+  // The queries are independent: process them in batches, so that part of the
+  // work can be done concurrently without keeping in memory the intermediate
+  // results of all of them
+  constexpr size_t BatchSize = 256;
+  for (size_t Start = 0; Start < Queries.size(); Start += BatchSize) {
+    auto Batch = llvm::makeArrayRef(Queries).slice(Start).take_front(BatchSize);
+    auto AllResults = ValueMaterializer::getValuesFor(Batch, MO, LVI, DT);
+
+    for (size_t Index = 0; Index < AllResults.size(); ++Index) {
+      const MarkerInfo &Info = Markers[Start + Index];
+      ValueMaterializer &Results = AllResults[Index];
+      CallBase *Call = Info.Call;
+      Value *ToTrack = Batch[Index].V;
+
+      MaterializedValues Values;
+      if (Results.values())
+        Values = std::move(*Results.values());
+
+      if (Info.Dump) {
+        // User asked to dump information about this address
+        dbg << "Values produced by ValueMaterializer for " << getName(ToTrack)
+            << " at " << Info.Address.toString() << ":\n";
+        for (const MaterializedValue &V : Values) {
+          dbg << "  ";
+          V.dump(dbg);
+          dbg << "\n";
+        }
+
+        dbg << "Dumping graphs\n";
+        Results.dataFlowGraph().dump();
+        AdvancedValueInfoMFI::dump(&Results.cfeg(), Results.mfiResult());
       }
 
-      dbg << "Dumping graphs\n";
-      Results.dataFlowGraph().dump();
-      AdvancedValueInfoMFI::dump(&Results.cfeg(), Results.mfiResult());
-    }
+      //
+      // Create a revng.avi metadata containing the type of instruction and
+      // all the possible values we identified
+      //
+      QuickMetadata QMD(getContext(&F));
+      std::vector<Metadata *> ValuesMD;
+      ValuesMD.reserve(Values.size());
+      for (const MaterializedValue &V : Values) {
+        // TODO: we are we ignoring those with symbols
+        auto Offset = V.value();
+        std::string SymbolName;
+        if (V.hasSymbol())
+          SymbolName = V.symbolName();
+
+        ValuesMD.push_back(QMD.tuple({ QMD.get(SymbolName),
+                                       QMD.get(Offset) }));
+      }
 
-    //
-    // Create a revng.avi metadata containing the type of instruction and
-    // all the possible values we identified
-    //
-    QuickMetadata QMD(getContext(&F));
-    std::vector<Metadata *> ValuesMD;
-    ValuesMD.reserve(Values.size());
-    for (const MaterializedValue &V : Values) {
-      // TODO: we are we ignoring those with symbols
-      auto Offset = V.value();
-      std::string SymbolName;
-      if (V.hasSymbol())
-        SymbolName = V.symbolName();
-
-      ValuesMD.push_back(QMD.tuple({ QMD.get(SymbolName), QMD.get(Offset) }));
+      Call->setMetadata("revng.avi", QMD.tuple(ValuesMD));
     }
-
-    Call->setMetadata("revng.avi", QMD.tuple(ValuesMD));
   }
 
+  // Results that have not been used in this round are no longer useful
+  Cache.endRound();
+
   return PreservedAnalyses::all();
 }
@@ -35,10 +35,13 @@ class ValueMaterializerPass
   : public llvm::PassInfoMixin<ValueMaterializerPass> {
 private:
   StaticDataMemoryOracle &MO;
+  ValueMaterializerCache &Cache;
   static constexpr const char *MarkerName = "revng_avi";
 
 public:
-  ValueMaterializerPass(StaticDataMemoryOracle &MO) : MO(MO) {}
+  ValueMaterializerPass(StaticDataMemoryOracle &MO,
+                        ValueMaterializerCache &Cache) :
+    MO(MO), Cache(Cache) {}
 
   llvm::PreservedAnalyses run(llvm::Function &F,
                               llvm::FunctionAnalysisManager &);
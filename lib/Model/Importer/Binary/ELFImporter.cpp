@@ -758,6 +758,8 @@ void ELFImporter<T, HasAddend>::parseProgramHeaders(ELFFile<T> &TheELF) {
     DynamicPhdr = nullptr;
     DynamicAddress = {};
   }
+
+  File.reindex();
 }
 
 template<typename T, bool HasAddend>
@@ -250,6 +250,8 @@ Error MachOImporter::import() {
     }
   }
 
+  File.reindex();
+
   if (EntryPointOffset) {
     using namespace model::Architecture;
     auto LLVMArchitecture = toLLVMArchitecture(Model->Architecture());
@@ -0,0 +1,133 @@
+/// \file RawBinaryView.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <limits>
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/Model/RawBinaryView.h"
+
+using namespace llvm;
+
+SegmentIntervalIndex::SegmentIntervalIndex(ArrayRef<Range> Ranges) {
+  for (const Range &R : Ranges) {
+    if (R.Start < R.End) {
+      Boundaries.push_back(R.Start);
+      Boundaries.push_back(R.End);
+    }
+  }
+
+  llvm::sort(Boundaries);
+  Boundaries.erase(std::unique(Boundaries.begin(), Boundaries.end()),
+                   Boundaries.end());
+
+  if (Boundaries.empty())
+    return;
+
+  auto IndexOf = [this](uint64_t Boundary) -> size_t {
+    auto It = llvm::lower_bound(Boundaries, Boundary);
+    revng_assert(It != Boundaries.end() and *It == Boundary);
+    return std::distance(Boundaries.begin(), It);
+  };
+
+  // Count how many segments cover each interval
+  size_t IntervalsCount = Boundaries.size() - 1;
+  FirstCovering.assign(IntervalsCount + 1, 0);
+  for (const Range &R : Ranges) {
+    if (R.Start >= R.End)
+      continue;
+
+    for (size_t I = IndexOf(R.Start), End = IndexOf(R.End); I < End; ++I)
+      FirstCovering[I + 1] += 1;
+  }
+
+  for (size_t I = 0; I < IntervalsCount; ++I)
+    FirstCovering[I + 1] += FirstCovering[I];
+
+  // Record the covering segments, preserving the order of Ranges
+  Covering.resize(FirstCovering.back());
+  std::vector<uint32_t> Cursors(FirstCovering.begin(),
+                                std::prev(FirstCovering.end()));
+  for (const Range &R : Ranges) {
+    if (R.Start >= R.End)
+      continue;
+
+    for (size_t I = IndexOf(R.Start), End = IndexOf(R.End); I < End; ++I)
+      Covering[Cursors[I]++] = R.Segment;
+  }
+}
+
+void RawBinaryView::buildIndexes() {
+  using Range = SegmentIntervalIndex::Range;
+  constexpr uint64_t Max = std::numeric_limits<uint64_t>::max();
+
+  std::vector<Range> Addresses;
+  std::vector<Range> Offsets;
+  for (const model::Segment &Segment : Binary.Segments()) {
+    // Segments spanning past the end of the address space are clamped
+    uint64_t Start = Segment.StartAddress().address();
+    auto End = OverflowSafeInt(Start) + Segment.VirtualSize();
+    Addresses.push_back({ Start, End ? *End : Max, &Segment });
+
+    auto EndOffset = OverflowSafeInt(Segment.StartOffset())
+                     + Segment.FileSize();
+    Offsets.push_back({ Segment.StartOffset(),
+                        EndOffset ? *EndOffset : Max,
+                        &Segment });
+  }
+
+  AddressIndex = SegmentIntervalIndex(Addresses);
+  OffsetIndex = SegmentIntervalIndex(Offsets);
+
+  const auto &Segments = Binary.Segments();
+  IndexedSegments = Segments.empty() ? nullptr : &*Segments.begin();
+  IndexedSegmentsCount = Segments.size();
+}
+
+RawBinaryView::SegmentsVector
+RawBinaryView::segmentsAt(MetaAddress Address) const {
+  SegmentsVector Result;
+  if (Address.isInvalid())
+    return Result;
+
+  auto Contains = [Address](const model::Segment &Segment) {
+    return Segment.contains(Address);
+  };
+
+  if (areIndexesUpToDate()) {
+    for (const model::Segment *Segment :
+         AddressIndex.lookup(Address.address()))
+      if (Contains(*Segment))
+        Result.push_back(Segment);
+  } else {
+    for (const model::Segment &Segment : Binary.Segments())
+      if (Contains(Segment))
+        Result.push_back(&Segment);
+  }
+
+  return Result;
+}
+
+RawBinaryView::SegmentsVector
+RawBinaryView::segmentsAtOffset(uint64_t Offset) const {
+  SegmentsVector Result;
+
+  auto Contains = [Offset](const model::Segment &Segment) {
+    return Segment.StartOffset() <= Offset and Offset < Segment.endOffset();
+  };
+
+  if (areIndexesUpToDate()) {
+    for (const model::Segment *Segment : OffsetIndex.lookup(Offset))
+      if (Contains(*Segment))
+        Result.push_back(Segment);
+  } else {
+    for (const model::Segment &Segment : Binary.Segments())
+      if (Contains(Segment))
+        Result.push_back(&Segment);
+  }
+
+  return Result;
+}
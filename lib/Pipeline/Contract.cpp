@@ -39,15 +39,12 @@ void Contract::deduceResults(const Context &Ctx,
 
 static TargetsList copyEntriesOfKind(const TargetsList &List, const Kind &K) {
   auto Range = List.filterByKind(K);
-  TargetsList ToReturn;
-  copy(Range.begin(), Range.end(), std::back_inserter(ToReturn));
-  return ToReturn;
+  return TargetsList::List(Range.begin(), Range.end());
 }
 
 static TargetsList extracEntriesOfKind(TargetsList &List, const Kind &K) {
   auto Range = List.filterByKind(K);
-  TargetsList ToReturn;
-  copy(Range.begin(), Range.end(), std::back_inserter(ToReturn));
+  TargetsList ToReturn = TargetsList::List(Range.begin(), Range.end());
   List.erase(Range.begin(), Range.end());
   return ToReturn;
 }
@@ -70,7 +67,7 @@ void Contract::deduceResults(const Context &Ctx,
                      extracEntriesOfKind(SourceContainerTargets, *Kind) :
                      copyEntriesOfKind(SourceContainerTargets, *Kind);
     Targets = forward(Ctx, std::move(Targets));
-    copy(Targets, back_inserter(Results));
+    Results.merge(Targets);
   }
 }
 
@@ -136,7 +133,7 @@ void Contract::deduceRequirements(const Context &Ctx,
     // they are transformed by the current Pipe
     Targets = backward(Ctx, std::move(Targets));
 
-    copy(Targets, back_inserter(Source));
+    Source.merge(Targets);
   }
 }
 
@@ -5,9 +5,21 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
 #include "llvm/PassRegistry.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/ExecutionContext.h"
 #include "revng/Pipeline/GenericLLVMPipe.h"
 #include "revng/Pipeline/LLVMContainer.h"
 #include "revng/Support/IRHelpers.h"
@@ -17,6 +29,13 @@ using namespace llvm;
 using namespace pipeline;
 using namespace cl;
 
+static cl::opt<unsigned> LLVMPipeThreads("llvm-pipe-threads",
+                                         cl::desc("Number of threads used to "
+                                                  "run function local LLVM "
+                                                  "pipes, 0 means one per "
+                                                  "hardware thread"),
+                                         cl::init(1));
+
 void O2Pipe::registerPasses(llvm::legacy::PassManager &Manager) {
   StringMap<llvm::cl::Option *> &Options(getRegisteredOptions());
   getOption<bool>(Options, "disable-machine-licm")->setInitialValue(true);
@@ -29,13 +48,104 @@ std::unique_ptr<LLVMPassWrapperBase> PureLLVMPassWrapper::clone() const {
   return std::make_unique<PureLLVMPassWrapper>(*this);
 }
 
-void GenericLLVMPipe::run(const ExecutionContext &, LLVMContainer &Container) {
-  llvm::legacy::PassManager Manager;
+void GenericLLVMPipe::registerPasses(llvm::legacy::PassManager &Manager) {
   for (const auto &Element : Passes)
     Element->registerPasses(Manager);
+}
+
+void GenericLLVMPipe::run(const ExecutionContext &Ctx,
+                          LLVMContainer &Container) {
+  unsigned ThreadsCount = LLVMPipeThreads;
+  if (ThreadsCount == 0)
+    ThreadsCount = llvm::hardware_concurrency().compute_thread_count();
+
+  if (ThreadsCount > 1 and isFunctionLocal()) {
+    runSharded(Ctx, Container, ThreadsCount);
+    return;
+  }
+
+  llvm::legacy::PassManager Manager;
+  registerPasses(Manager);
   Manager.run(Container.getModule());
 }
 
+static std::string toBitcode(const llvm::Module &Module) {
+  std::string Result;
+  llvm::raw_string_ostream Stream(Result);
+  llvm::WriteBitcodeToFile(Module, Stream);
+  Stream.flush();
+  return Result;
+}
+
+static std::unique_ptr<llvm::Module> fromBitcode(llvm::StringRef Bitcode,
+                                                 llvm::LLVMContext &Context) {
+  llvm::MemoryBufferRef Buffer(Bitcode, "revng.shard");
+  return llvm::cantFail(llvm::parseBitcodeFile(Buffer, Context));
+}
+
+void GenericLLVMPipe::runSharded(const ExecutionContext &Ctx,
+                                 LLVMContainer &Container,
+                                 unsigned ThreadsCount) {
+  TargetsList Targets = Container.enumerate();
+  size_t ShardsCount = std::min<size_t>(ThreadsCount, Targets.size());
+
+  if (ShardsCount < 2) {
+    llvm::legacy::PassManager Manager;
+    registerPasses(Manager);
+    Manager.run(Container.getModule());
+    return;
+  }
+
+  // Split the targets in contiguous chunks and clone each of them in a module
+  // of its own. Modules cross the LLVMContext boundary as bitcode.
+  std::vector<std::string> Shards(ShardsCount);
+  std::vector<std::unique_ptr<llvm::legacy::PassManager>> Managers;
+  for (size_t I = 0; I < ShardsCount; ++I) {
+    auto Begin = Targets.begin() + (Targets.size() * I) / ShardsCount;
+    auto End = Targets.begin() + (Targets.size() * (I + 1)) / ShardsCount;
+    TargetsList::List ShardTargets(Begin, End);
+
+    auto Cloned = Container.cloneFiltered(std::move(ShardTargets));
+    Shards[I] = toBitcode(llvm::cast<LLVMContainer>(*Cloned).getModule());
+
+    // Registering passes is not thread safe (e.g., it can alter llvm::cl
+    // options), populate all the pass managers upfront
+    Managers.push_back(std::make_unique<llvm::legacy::PassManager>());
+    registerPasses(*Managers.back());
+  }
+
+  // Tracking model accesses is not thread safe: suspend it while the shards
+  // run and then conservatively record a read of the whole model
+  const Context &PipelineContext = Ctx.getContext();
+  PipelineContext.stopTracking();
+
+  llvm::ThreadPool Pool(llvm::hardware_concurrency(ShardsCount));
+  for (size_t I = 0; I < ShardsCount; ++I) {
+    Pool.async([&Shards, &Managers, I]() {
+      llvm::LLVMContext ShardContext;
+      std::unique_ptr<llvm::Module> Module = fromBitcode(Shards[I],
+                                                         ShardContext);
+      Managers[I]->run(*Module);
+      Managers[I].reset();
+      Shards[I] = toBitcode(*Module);
+    });
+  }
+  Pool.wait();
+
+  PipelineContext.clearAndResume();
+  PipelineContext.markAllRead();
+
+  // Link the shards back, in order, in the original LLVMContext
+  llvm::LLVMContext &LLVMCtx = Container.getModule().getContext();
+  Container.clear();
+  for (const std::string &Shard : Shards) {
+    LLVMContainer Result(Container.name(),
+                         &Container.getContext(),
+                         fromBitcode(Shard, LLVMCtx));
+    Container.mergeBack(std::move(Result));
+  }
+}
+
 void PureLLVMPassWrapper::registerPasses(llvm::legacy::PassManager &Manager) {
   auto *Registry = llvm::PassRegistry::getPassRegistry();
   Manager.add(Registry->getPassInfo(PassName)->createPass());
@@ -0,0 +1,368 @@
+/// \file InvalidationMetadata.cpp
+/// The on-disk representation of the invalidation metadata of a step.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/LEB128.h"
+
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/InvalidationMetadata.h"
+#include "revng/Support/Assert.h"
+
+using namespace llvm;
+using namespace pipeline;
+
+llvm::Expected<llvm::SmallVector<TargetInContainer, 2>>
+TargetInPipe::deserialize(const Context &Ctx,
+                          llvm::StringRef ContainerName) const {
+  TargetsList Targets;
+  llvm::Error Error = parseTarget(Ctx,
+                                  SerializedTarget,
+                                  Ctx.getKindsRegistry(),
+                                  Targets);
+  if (Error)
+    return std::move(Error);
+
+  llvm::SmallVector<TargetInContainer, 2> Return;
+  for (const Target &Target : Targets) {
+    Return.emplace_back(std::move(Target), ContainerName.str());
+  }
+  return Return;
+}
+
+TargetInPipe
+TargetInPipe::fromTargetInContainer(const TargetInContainer &Target,
+                                    llvm::StringRef PipeName) {
+  TargetInPipe ToReturn;
+  ToReturn.PipeName = PipeName;
+  ToReturn.SerializedTarget = Target.getTarget().serialize();
+
+  return ToReturn;
+}
+
+ContainerInvalidationMetadata
+ContainerInvalidationMetadata::serialize(const TargetsInterner &Interner,
+                                         const PathTargetBimap &Map,
+                                         const Global &Global,
+                                         llvm::StringRef PipeName,
+                                         llvm::StringRef ContainerName) {
+  ContainerInvalidationMetadata ToSerialize;
+  std::map<pipeline::TargetInPipe, ValueType> TemporaryMap;
+
+  for (const auto &Content : Map) {
+    std::optional<std::string> AsString;
+    uint64_t Hash = 0;
+    for (TargetsInterner::ID ID : Content.second) {
+      const TargetInContainer &Entry = Interner.get(ID);
+      if (Entry.getContainerName() != ContainerName)
+        continue;
+
+      // Serialize and hash the path only once, and only if needed
+      if (not AsString.has_value()) {
+        AsString = Global.serializePath(Content.first);
+        revng_check(AsString.has_value());
+        Hash = Global.hashPath(Content.first).value_or(0);
+      }
+
+      auto Key = TargetInPipe::fromTargetInContainer(Entry, PipeName);
+      ValueType &Value = TemporaryMap[Key];
+      Value.ReadPaths.push_back(*AsString);
+      Value.Hashes.push_back(Hash);
+    }
+  }
+
+  for (auto &Content : TemporaryMap) {
+    Content.second.Target = Content.first;
+    ToSerialize.Data.emplace_back(std::move(Content.second));
+  }
+
+  return ToSerialize;
+}
+
+llvm::Expected<const llvm::SmallVector<TargetInContainer, 2> *>
+InvalidationMetadataCache::getTargets(const Context &Ctx,
+                                      const TargetInPipe &Target,
+                                      llvm::StringRef ContainerName) {
+  auto It = Targets.find(Target.SerializedTarget);
+  if (It == Targets.end()) {
+    auto MaybeTargets = Target.deserialize(Ctx, ContainerName);
+    if (not MaybeTargets)
+      return MaybeTargets.takeError();
+    It = Targets.try_emplace(Target.SerializedTarget, std::move(*MaybeTargets))
+           .first;
+  }
+  return &It->second;
+}
+
+InvalidationMetadataCache::ParsedPath *
+InvalidationMetadataCache::getPath(const Global &Global,
+                                   llvm::StringRef SerializedPath) {
+  auto &GlobalPaths = Paths[Global.getName()];
+  auto It = GlobalPaths.find(SerializedPath);
+  if (It == GlobalPaths.end()) {
+    std::optional<TupleTreePath>
+      MaybeParsedPath = Global.deserializePath(SerializedPath);
+    if (not MaybeParsedPath)
+      return nullptr;
+    ParsedPath Parsed;
+    Parsed.Path = std::move(*MaybeParsedPath);
+    It = GlobalPaths.try_emplace(SerializedPath, std::move(Parsed)).first;
+  }
+  return &It->second;
+}
+
+llvm::Expected<PathTargetBimap>
+ContainerInvalidationMetadata::deserialize(const Context &Ctx,
+                                           const Global &Global,
+                                           llvm::StringRef PipeName,
+                                           llvm::StringRef ContainerName,
+                                           InvalidationMetadataCache &Cache,
+                                           TargetsList &Stale) const {
+
+  TargetsInterner &Interner = Ctx.getTargetsInterner();
+  PathTargetBimap ToReturn;
+  auto StaleInserter = Stale.batch_insert();
+  for (const ValueType &Entry : Data) {
+    if (Entry.Target.PipeName != PipeName)
+      continue;
+    auto MaybeTargets = Cache.getTargets(Ctx, Entry.Target, ContainerName);
+    if (not MaybeTargets)
+      return MaybeTargets.takeError();
+
+    llvm::SmallVector<TargetsInterner::ID, 2> IDs;
+    for (const TargetInContainer &Target : **MaybeTargets)
+      IDs.push_back(Interner.intern(Target));
+
+    bool HasHashes = not Entry.Hashes.empty();
+    if (HasHashes and Entry.Hashes.size() != Entry.ReadPaths.size())
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "mismatching number of hashes for "
+                                       + Entry.Target.SerializedTarget);
+
+    bool IsStale = false;
+    for (const auto &PathAndIndex : llvm::enumerate(Entry.ReadPaths)) {
+      const std::string &SerializedPath = PathAndIndex.value();
+      auto *Parsed = Cache.getPath(Global, SerializedPath);
+      if (Parsed == nullptr)
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "could not parse " + SerializedPath);
+
+      if (HasHashes and not IsStale) {
+        uint64_t Hash = Entry.Hashes[PathAndIndex.index()];
+        IsStale = Cache.getHash(Global, *Parsed).value_or(0) != Hash;
+      }
+
+      for (TargetsInterner::ID ID : IDs)
+        ToReturn.insert(ID, Parsed->Path);
+    }
+
+    if (IsStale)
+      for (const TargetInContainer &Target : **MaybeTargets)
+        StaleInserter.insert(Target.getTarget());
+  }
+
+  return ToReturn;
+}
+
+namespace pipeline::binary_metadata {
+
+static constexpr llvm::StringLiteral Magic = "RVNGINVM";
+static constexpr uint64_t Version = 1;
+
+bool isBinary(llvm::StringRef Buffer) {
+  return Buffer.startswith(Magic);
+}
+
+void write(llvm::raw_ostream &OS,
+           const InvalidationMetadataVector &ToStore) {
+  llvm::StringMap<uint64_t> Indices;
+  std::vector<llvm::StringRef> Strings;
+  auto Intern = [&Indices, &Strings](llvm::StringRef String) {
+    auto [It, Inserted] = Indices.try_emplace(String, Strings.size());
+    if (Inserted)
+      Strings.push_back(It->first());
+    return It->second;
+  };
+
+  // Emit the body first, so that the string table is complete
+  std::string Body;
+  llvm::raw_string_ostream BodyOS(Body);
+  encodeULEB128(ToStore.size(), BodyOS);
+  for (const NamedPathTargetBimapVector &Entry : ToStore) {
+    encodeULEB128(Intern(Entry.GlobalName), BodyOS);
+    encodeULEB128(Entry.Map.Data.size(), BodyOS);
+    for (const auto &Value : Entry.Map.Data) {
+      encodeULEB128(Intern(Value.Target.SerializedTarget), BodyOS);
+      encodeULEB128(Intern(Value.Target.PipeName), BodyOS);
+      encodeULEB128(Value.ReadPaths.size(), BodyOS);
+      for (const std::string &Path : Value.ReadPaths)
+        encodeULEB128(Intern(Path), BodyOS);
+
+      bool HasHashes = not Value.Hashes.empty();
+      revng_assert(not HasHashes
+                   or Value.Hashes.size() == Value.ReadPaths.size());
+      BodyOS << static_cast<char>(HasHashes);
+      for (uint64_t Hash : Value.Hashes)
+        support::endian::write<uint64_t>(BodyOS, Hash, support::little);
+    }
+  }
+  BodyOS.flush();
+
+  OS << Magic;
+  encodeULEB128(Version, OS);
+  encodeULEB128(Strings.size(), OS);
+  for (llvm::StringRef String : Strings) {
+    encodeULEB128(String.size(), OS);
+    OS << String;
+  }
+  OS << Body;
+}
+
+/// Reads the binary format straight out of the buffer of the file: strings
+/// are only copied when the entries referring to them are materialized
+class Reader {
+private:
+  const uint8_t *Cursor;
+  const uint8_t *End;
+  std::vector<llvm::StringRef> Strings;
+
+public:
+  explicit Reader(llvm::StringRef Buffer) :
+    Cursor(Buffer.bytes_begin()), End(Buffer.bytes_end()) {}
+
+public:
+  llvm::Expected<InvalidationMetadataVector> read() {
+    llvm::StringRef Buffer(reinterpret_cast<const char *>(Cursor),
+                           End - Cursor);
+    if (not isBinary(Buffer) or not skip(Magic.size()))
+      return malformed();
+
+    auto MaybeVersion = readNumber();
+    if (not MaybeVersion)
+      return malformed();
+    if (*MaybeVersion != Version)
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "unsupported invalidation metadata "
+                                     "version "
+                                       + std::to_string(*MaybeVersion));
+
+    auto StringsCount = readCount();
+    if (not StringsCount)
+      return malformed();
+    Strings.reserve(*StringsCount);
+    for (uint64_t I = 0; I < *StringsCount; ++I) {
+      auto Size = readNumber();
+      if (not Size or static_cast<uint64_t>(End - Cursor) < *Size)
+        return malformed();
+      Strings.emplace_back(reinterpret_cast<const char *>(Cursor), *Size);
+      Cursor += *Size;
+    }
+
+    InvalidationMetadataVector Result;
+    auto GlobalsCount = readCount();
+    if (not GlobalsCount)
+      return malformed();
+    for (uint64_t I = 0; I < *GlobalsCount; ++I) {
+      NamedPathTargetBimapVector &Entry = Result.emplace_back();
+      auto GlobalName = readString();
+      auto EntriesCount = readCount();
+      if (not GlobalName or not EntriesCount)
+        return malformed();
+      Entry.GlobalName = *GlobalName;
+
+      auto &Data = Entry.Map.Data;
+      Data.reserve(*EntriesCount);
+      for (uint64_t J = 0; J < *EntriesCount; ++J)
+        if (not readEntry(Data.emplace_back()))
+          return malformed();
+    }
+
+    if (Cursor != End)
+      return malformed();
+
+    return Result;
+  }
+
+private:
+  bool readEntry(ContainerInvalidationMetadata::ValueType &Value) {
+    auto Target = readString();
+    auto PipeName = readString();
+    auto PathsCount = readCount();
+    if (not Target or not PipeName or not PathsCount)
+      return false;
+    Value.Target.SerializedTarget = *Target;
+    Value.Target.PipeName = *PipeName;
+
+    Value.ReadPaths.reserve(*PathsCount);
+    for (uint64_t I = 0; I < *PathsCount; ++I) {
+      auto Path = readString();
+      if (not Path)
+        return false;
+      Value.ReadPaths.emplace_back(*Path);
+    }
+
+    if (Cursor == End)
+      return false;
+    bool HasHashes = *Cursor++ != 0;
+    if (not HasHashes)
+      return true;
+
+    if (static_cast<uint64_t>(End - Cursor) / 8 < *PathsCount)
+      return false;
+    Value.Hashes.reserve(*PathsCount);
+    for (uint64_t I = 0; I < *PathsCount; ++I) {
+      Value.Hashes.push_back(support::endian::read64le(Cursor));
+      Cursor += 8;
+    }
+
+    return true;
+  }
+
+  std::optional<uint64_t> readNumber() {
+    unsigned Size = 0;
+    const char *Error = nullptr;
+    uint64_t Result = decodeULEB128(Cursor, &Size, End, &Error);
+    if (Error != nullptr)
+      return std::nullopt;
+    Cursor += Size;
+    return Result;
+  }
+
+  /// Reads the number of elements that follow, each of which takes at least a
+  /// byte, so that it can be safely used to reserve memory
+  std::optional<uint64_t> readCount() {
+    auto Result = readNumber();
+    if (not Result or *Result > static_cast<uint64_t>(End - Cursor))
+      return std::nullopt;
+    return Result;
+  }
+
+  std::optional<llvm::StringRef> readString() {
+    auto Index = readNumber();
+    if (not Index or *Index >= Strings.size())
+      return std::nullopt;
+    return Strings[*Index];
+  }
+
+  bool skip(size_t Size) {
+    if (static_cast<size_t>(End - Cursor) < Size)
+      return false;
+    Cursor += Size;
+    return true;
+  }
+
+  static llvm::Error malformed() {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "malformed binary invalidation metadata");
+  }
+};
+
+llvm::Expected<InvalidationMetadataVector> read(llvm::StringRef Buffer) {
+  return Reader(Buffer).read();
+}
+
+} // namespace pipeline::binary_metadata
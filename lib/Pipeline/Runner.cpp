@@ -5,8 +5,14 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Progress.h"
@@ -23,6 +29,50 @@ using namespace std;
 using namespace llvm;
 using namespace pipeline;
 
+static cl::opt<bool> FullGlobalsDiff("full-globals-diff",
+                                     cl::desc("compute the changes performed "
+                                              "by analyses on the globals by "
+                                              "copying them upfront, rather "
+                                              "than tracking writes"),
+                                     cl::init(false));
+
+namespace {
+
+/// Records the changes performed on the globals while it is alive
+class GlobalsChangesRecorder {
+private:
+  GlobalsMap &Globals;
+  std::optional<GlobalsMap> Before;
+  bool Collected = false;
+
+public:
+  explicit GlobalsChangesRecorder(GlobalsMap &Globals) : Globals(Globals) {
+    if (FullGlobalsDiff)
+      Before = Globals;
+    else
+      Globals.startWriteTracking();
+  }
+
+  ~GlobalsChangesRecorder() {
+    if (not Collected)
+      collect();
+  }
+
+  GlobalsChangesRecorder(const GlobalsChangesRecorder &) = delete;
+  GlobalsChangesRecorder &operator=(const GlobalsChangesRecorder &) = delete;
+
+public:
+  DiffMap collect() {
+    revng_assert(not Collected);
+    Collected = true;
+    if (Before.has_value())
+      return Before->diff(Globals);
+    return Globals.collectWrites();
+  }
+};
+
+} // namespace
+
 class PipelineExecutionEntry {
 public:
   Step *ToExecute;
@@ -227,13 +277,21 @@ Error Runner::load(const revng::DirectoryPath &DirPath) {
   if (auto Error = TheContext->load(ContextDir); !!Error)
     return Error;
 
+  // Drop the cached targets that depend on parts of the globals that have
+  // changed since they were stored, and everything deduced from them
+  TargetInStepSet Stale;
   for (auto &Step : Steps) {
     revng::DirectoryPath StepDir = DirPath.getDirectory(Step.first());
-    if (auto Error = Step.second.load(StepDir); !!Error)
+    ContainerToTargetsMap &StaleInStep = Stale[Step.first()];
+    if (auto Error = Step.second.load(StepDir, StaleInStep); !!Error)
       return Error;
+    Step.second.containers().intersect(StaleInStep);
   }
 
-  return Error::success();
+  if (llvm::Error Error = getInvalidations(Stale); !!Error)
+    return Error;
+
+  return invalidate(Stale);
 }
 
 std::vector<revng::FilePath>
@@ -261,7 +319,7 @@ Runner::runAnalysis(llvm::StringRef AnalysisName,
                     TargetInStepSet &InvalidationsMap,
                     const llvm::StringMap<std::string> &Options) {
 
-  GlobalsMap Before = getContext().getGlobals();
+  GlobalsChangesRecorder Recorder(TheContext->getGlobals());
 
   auto MaybeStep = Steps.find(StepName);
 
@@ -285,8 +343,7 @@ Runner::runAnalysis(llvm::StringRef AnalysisName,
   }
 
   T.advance("Apply diff produced by the analysis", true);
-  const GlobalsMap &After = getContext().getGlobals();
-  DiffMap Map = Before.diff(After);
+  DiffMap Map = Recorder.collect();
   for (const auto &GlobalNameDiffPair : Map)
     if (llvm::Error Error = apply(GlobalNameDiffPair.second, InvalidationsMap))
       return std::move(Error);
@@ -299,7 +356,7 @@ llvm::Expected<DiffMap>
 Runner::runAnalyses(const AnalysesList &List,
                     TargetInStepSet &InvalidationsMap,
                     const llvm::StringMap<std::string> &Options) {
-  GlobalsMap Before = getContext().getGlobals();
+  GlobalsChangesRecorder Recorder(TheContext->getGlobals());
 
   Task T(List.size() + 1, "Analysis list " + List.getName());
   for (const AnalysisReference &Ref : List) {
@@ -328,8 +385,7 @@ Runner::runAnalyses(const AnalysesList &List,
   }
 
   T.advance("Computing analysis list diff", true);
-  const GlobalsMap &After = getContext().getGlobals();
-  return Before.diff(After);
+  return Recorder.collect();
 }
 
 Error Runner::run(const State &ToProduce) {
@@ -409,9 +465,28 @@ Error Runner::invalidate(const TargetInStepSet &Invalidations) {
     if (llvm::Error Error = operator[](StepName).invalidate(ToRemove); Error)
       return Error;
   }
+
+  compactTargetsInterner();
   return Error::success();
 }
 
+void Runner::compactTargetsInterner() {
+  static constexpr size_t MinimumSize = 1024;
+  TargetsInterner &Interner = TheContext->getTargetsInterner();
+  if (Interner.size() < std::max(2 * CompactedInternerSize, MinimumSize))
+    return;
+
+  llvm::BitVector Live(Interner.size());
+  for (const auto &Entry : Steps)
+    Entry.second.collectTargets(Live);
+
+  std::vector<TargetsInterner::ID> NewIDs = Interner.compact(Live);
+  for (auto &Entry : Steps)
+    Entry.second.remapTargets(NewIDs);
+
+  CompactedInternerSize = Interner.size();
+}
+
 void Runner::getCurrentState(State &Out) const {
   for (const auto &Step : Steps) {
     const auto &Under = Step.second;
@@ -447,13 +522,14 @@ void Runner::getDiffInvalidations(const GlobalTupleTreeDiff &Diff,
       const TargetsList &ExistingTargets = Container.second->enumerate();
       // for all targets that are not cached anywhere, mark them to be deleated
       // every time, since we must be conservative
+      auto Inserter = StepInvalidations[Container.first()].batch_insert();
       for (const Target &Target : ExistingTargets) {
 
         TargetInContainer ToFind(Target, Container.first().str());
         if (Step.invalidationMetadataContains(Diff.getGlobalName(), ToFind))
           continue;
 
-        StepInvalidations[Container.first()].push_back(Target);
+        Inserter.insert(Target);
       }
     }
 
@@ -6,6 +6,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
@@ -15,6 +16,7 @@
 #include "revng/Pipeline/ContainerSet.h"
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/Errors.h"
+#include "revng/Pipeline/InvalidationMetadata.h"
 #include "revng/Pipeline/Step.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Support/Assert.h"
@@ -24,191 +26,13 @@ using namespace llvm;
 using namespace std;
 using namespace pipeline;
 
-namespace pipeline {
-
-class TargetInPipe {
-public:
-  std::string SerializedTarget;
-  std::string PipeName;
-
-  llvm::Expected<llvm::SmallVector<TargetInContainer, 2>>
-  deserialize(const Context &Ctx, llvm::StringRef ContainerName) const;
-
-  static TargetInPipe fromTargetInContainer(const TargetInContainer &Target,
-                                            llvm::StringRef PipeName);
-  bool operator<(const TargetInPipe &Other) const {
-    const auto &Tied = std::tie(SerializedTarget, PipeName);
-    return Tied < std::tie(Other.SerializedTarget, Other.PipeName);
-  }
-};
-
-class ContainerInvalidationMetadata {
-public:
-  using ValueType = std::pair<pipeline::TargetInPipe, std::vector<std::string>>;
-  using Vector = std::vector<ValueType>;
-  Vector Data;
-
-  void merge(ContainerInvalidationMetadata &&Other) {
-    for (ValueType &Entry : Other.Data)
-      Data.emplace_back(std::move(Entry));
-  }
-
-public:
-  llvm::Expected<PathTargetBimap>
-  deserialize(const Context &Ctx,
-              const Global &Primitives,
-              llvm::StringRef PipeName,
-              llvm::StringRef ContainerName) const;
-
-  static ContainerInvalidationMetadata serialize(const PathTargetBimap &Map,
-                                                 const Global &Primitives,
-                                                 llvm::StringRef PipeName,
-                                                 llvm::StringRef ContainerName);
-};
-
-class NamedPathTargetBimapVector {
-public:
-  std::string GlobalName;
-  ContainerInvalidationMetadata Map;
-};
-} // namespace pipeline
-
-LLVM_YAML_IS_SEQUENCE_VECTOR(ContainerInvalidationMetadata::ValueType);
-
-namespace llvm {
-namespace yaml {
-
-// YAML traits for TargetInContainer
-template<>
-struct MappingTraits<pipeline::TargetInPipe> {
-  static void mapping(IO &IO, pipeline::TargetInPipe &TargetInContainer) {
-    IO.mapRequired("Target", TargetInContainer.SerializedTarget);
-    IO.mapRequired("PipeName", TargetInContainer.PipeName);
-  }
-};
-
-template<>
-struct MappingTraits<pipeline::ContainerInvalidationMetadata> {
-  static void mapping(IO &Io,
-                      pipeline::ContainerInvalidationMetadata &TargetMap) {
-    Io.mapRequired("Map", TargetMap.Data);
-  }
-};
-
-template<>
-struct MappingTraits<ContainerInvalidationMetadata::Vector::value_type> {
-  static void
-  mapping(IO &Io,
-          pipeline::ContainerInvalidationMetadata::Vector::value_type
-            &TargetMap) {
-    Io.mapRequired("Target", TargetMap.first.SerializedTarget);
-    Io.mapRequired("PipeName", TargetMap.first.PipeName);
-    Io.mapRequired("ReadPaths", TargetMap.second);
-  }
-};
-
-} // namespace yaml
-} // namespace llvm
-
-LLVM_YAML_IS_SEQUENCE_VECTOR(pipeline::NamedPathTargetBimapVector);
-
-namespace llvm {
-namespace yaml {
-template<>
-struct MappingTraits<pipeline::NamedPathTargetBimapVector> {
-  static void mapping(IO &Io, pipeline::NamedPathTargetBimapVector &TargetMap) {
-    Io.mapRequired("GlobalName", TargetMap.GlobalName);
-    Io.mapRequired("Map", TargetMap.Map.Data);
-  }
-};
-} // namespace yaml
-} // namespace llvm
-
-llvm::Expected<llvm::SmallVector<TargetInContainer, 2>>
-TargetInPipe::deserialize(const Context &Ctx,
-                          llvm::StringRef ContainerName) const {
-  TargetsList Targets;
-  llvm::Error Error = parseTarget(Ctx,
-                                  SerializedTarget,
-                                  Ctx.getKindsRegistry(),
-                                  Targets);
-  if (Error)
-    return std::move(Error);
-
-  llvm::SmallVector<TargetInContainer, 2> Return;
-  for (const Target &Target : Targets) {
-    Return.emplace_back(std::move(Target), ContainerName.str());
-  }
-  return Return;
-}
-
-TargetInPipe
-TargetInPipe::fromTargetInContainer(const TargetInContainer &Target,
-                                    llvm::StringRef PipeName) {
-  TargetInPipe ToReturn;
-  ToReturn.PipeName = PipeName;
-  ToReturn.SerializedTarget = Target.getTarget().serialize();
-
-  return ToReturn;
-}
-
-ContainerInvalidationMetadata
-ContainerInvalidationMetadata::serialize(const PathTargetBimap &Map,
-                                         const Global &Global,
-                                         llvm::StringRef PipeName,
-                                         llvm::StringRef ContainerName) {
-  ContainerInvalidationMetadata ToSerialize;
-  std::map<pipeline::TargetInPipe, std::vector<std::string>> TemporaryMap;
-
-  for (const auto &Content : Map) {
-    for (const TargetInContainer &Entry : Content.second) {
-      if (Entry.getContainerName() != ContainerName)
-        continue;
-
-      std::optional<std::string> AsString = Global.serializePath(Content.first);
-      revng_check(AsString.has_value());
-      TemporaryMap[TargetInPipe::fromTargetInContainer(Entry, PipeName)]
-        .push_back(*AsString);
-    }
-  }
-
-  for (const auto &Content : TemporaryMap) {
-    std::pair ToEmplace{ Content.first, Content.second };
-    ToSerialize.Data.emplace_back(std::move(ToEmplace));
-  }
-
-  return ToSerialize;
-}
-
-llvm::Expected<PathTargetBimap>
-ContainerInvalidationMetadata::deserialize(const Context &Ctx,
-                                           const Global &Global,
-                                           llvm::StringRef PipeName,
-                                           llvm::StringRef ContainerName)
-  const {
-
-  PathTargetBimap ToReturn;
-  for (const ValueType &Entry : Data) {
-    if (Entry.first.PipeName != PipeName)
-      continue;
-    llvm::Expected<SmallVector<TargetInContainer>>
-      MaybeTarget = Entry.first.deserialize(Ctx, ContainerName);
-    if (not MaybeTarget)
-      return MaybeTarget.takeError();
-
-    for (auto &SerializedPath : Entry.second) {
-      std::optional<TupleTreePath>
-        MaybeParsedPath = Global.deserializePath(SerializedPath);
-      if (not MaybeParsedPath)
-        return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                       "could not parse " + SerializedPath);
-      for (const TargetInContainer &Path : *MaybeTarget)
-        ToReturn.insert(std::move(Path), std::move(*MaybeParsedPath));
-    }
-  }
-
-  return ToReturn;
-}
+static cl::opt<bool> YAMLInvalidationMetadata("yaml-invalidation-metadata",
+                                              cl::desc("store the "
+                                                       "invalidation metadata "
+                                                       "as YAML rather than in "
+                                                       "binary form, for "
+                                                       "debugging purposes"),
+                                              cl::init(false));
 
 ContainerToTargetsMap
 Step::analyzeGoals(const ContainerToTargetsMap &RequiredGoals) const {
@@ -347,7 +171,7 @@ ContainerToTargetsMap Step::deduceResults(ContainerToTargetsMap Input) const {
 
 Error Step::invalidate(const ContainerToTargetsMap &ToRemove) {
   for (auto &Pipe : Pipes) {
-    Pipe.InvalidationMetadata.remove(ToRemove);
+    Pipe.InvalidationMetadata.remove(Ctx->getTargetsInterner(), ToRemove);
   }
   return containers().remove(ToRemove);
 }
@@ -369,7 +193,8 @@ Error Step::checkPrecondition() const {
   return llvm::Error::success();
 }
 
-Error Step::load(const revng::DirectoryPath &DirPath) {
+Error Step::load(const revng::DirectoryPath &DirPath,
+                 ContainerToTargetsMap &Stale) {
   auto MaybeBool = DirPath.exists();
   if (not MaybeBool)
     return MaybeBool.takeError();
@@ -380,12 +205,13 @@ Error Step::load(const revng::DirectoryPath &DirPath) {
   if (auto Error = Containers.load(DirPath))
     return Error;
 
-  return loadInvalidationMetadata(DirPath);
+  return loadInvalidationMetadata(DirPath, Stale);
 }
 
 llvm::Error
 Step::loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
-                                   ContainerSet::value_type &Container) {
+                                   ContainerSet::value_type &Container,
+                                   TargetsList &Stale) {
   auto FilePath = Path.getFile(Container.first().str() + ".cache");
   auto MaybeBool = FilePath.exists();
   if (not MaybeBool)
@@ -398,18 +224,25 @@ Step::loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
   if (not File)
     return File.takeError();
 
-  using Type = llvm::SmallVector<NamedPathTargetBimapVector, 2>;
-  auto Parsed = ::deserialize<Type>(File.get()->buffer().getBuffer());
+  // Files in the binary format are recognized by their header, anything else
+  // is YAML
+  llvm::StringRef Buffer = File.get()->buffer().getBuffer();
+  auto Parsed = binary_metadata::isBinary(Buffer) ?
+                  binary_metadata::read(Buffer) :
+                  ::deserialize<InvalidationMetadataVector>(Buffer);
   if (not Parsed)
     return Parsed.takeError();
 
+  InvalidationMetadataCache Cache;
   for (PipeWrapper &Pipe : Pipes) {
     for (NamedPathTargetBimapVector &Entry : *Parsed) {
       Global *Global = llvm::cantFail(Ctx->getGlobals().get(Entry.GlobalName));
       auto Parsed(Entry.Map.deserialize(*Ctx,
                                         *Global,
                                         Pipe.Pipe->getName(),
-                                        Container.first()));
+                                        Container.first(),
+                                        Cache,
+                                        Stale));
       if (not Parsed)
         return Parsed.takeError();
       Pipe.InvalidationMetadata.getPathCache(Global->getName())
@@ -419,13 +252,17 @@ Step::loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
   return llvm::Error::success();
 }
 
-llvm::Error Step::loadInvalidationMetadata(const revng::DirectoryPath &Path) {
+llvm::Error Step::loadInvalidationMetadata(const revng::DirectoryPath &Path,
+                                           ContainerToTargetsMap &Stale) {
 
   for (PipeWrapper &Pipe : Pipes) {
     Pipe.InvalidationMetadata = {};
   }
   for (auto &Container : Containers) {
-    if (llvm::Error Error = loadInvalidationMetadataImpl(Path, Container))
+    TargetsList &StaleInContainer = Stale[Container.first()];
+    if (llvm::Error Error = loadInvalidationMetadataImpl(Path,
+                                                         Container,
+                                                         StaleInContainer))
       return Error;
   }
 
@@ -438,8 +275,7 @@ Step::storeInvalidationMetadata(const revng::DirectoryPath &Path) const {
     if (Container.second == nullptr)
       continue;
 
-    using Type = llvm::SmallVector<NamedPathTargetBimapVector, 2>;
-    Type ToStore = {};
+    InvalidationMetadataVector ToStore = {};
 
     for (const Global *Global : Ctx->getGlobals()) {
       NamedPathTargetBimapVector Entry;
@@ -452,7 +288,8 @@ Step::storeInvalidationMetadata(const revng::DirectoryPath &Path) const {
 
         using MetadataType = ContainerInvalidationMetadata;
         auto Serialize = MetadataType::serialize;
-        MetadataType Serialized = Serialize(Pipe.InvalidationMetadata
+        MetadataType Serialized = Serialize(Ctx->getTargetsInterner(),
+                                            Pipe.InvalidationMetadata
                                               .getPathCache(Entry.GlobalName),
                                             *Global,
                                             Pipe.Pipe->getName(),
@@ -466,7 +303,10 @@ Step::storeInvalidationMetadata(const revng::DirectoryPath &Path) const {
                   .getWritableFile();
     if (not File)
       return File.takeError();
-    ::serialize(File->get()->os(), ToStore);
+    if (YAMLInvalidationMetadata)
+      ::serialize(File->get()->os(), ToStore);
+    else
+      binary_metadata::write(File->get()->os(), ToStore);
     if (auto Error = File->get()->commit())
       return Error;
   }
@@ -21,12 +21,15 @@ using namespace std;
 using namespace llvm;
 
 bool TargetsList::contains(const Target &Target) const {
-  return find(*this, Target) != end();
+  return std::binary_search(begin(), end(), Target);
 }
 
 void TargetsList::merge(const TargetsList &Source) {
+  // Both lists are sorted, a linear merge is enough
+  size_t OriginalSize = Contained.size();
   copy(Source, back_inserter(Contained));
-  llvm::sort(Contained);
+  auto Middle = Contained.begin() + OriginalSize;
+  std::inplace_merge(Contained.begin(), Middle, Contained.end());
   Contained.erase(unique(Contained.begin(), Contained.end()), Contained.end());
 }
 
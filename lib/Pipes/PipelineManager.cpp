@@ -7,6 +7,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <list>
 #include <memory>
 #include <string>
@@ -38,6 +39,14 @@ static cl::opt<bool> CheckComponentsVersion("check-components-version",
                                                      "don't match"),
                                             cl::init(false));
 
+static cl::opt<unsigned> ProduceBatchSize("produce-batch-size",
+                                          cl::desc("Maximum number of targets "
+                                                   "requested at once when "
+                                                   "producing all the "
+                                                   "possible targets, 0 means "
+                                                   "no limit"),
+                                          cl::init(0));
+
 class LoadModelPipePass {
 private:
   ModelWrapper Wrapper;
@@ -45,6 +54,10 @@ private:
 public:
   static constexpr auto Name = "load-model";
 
+  // Only provides the model to the other passes, it does not prevent them from
+  // being run on shards of the module
+  static constexpr bool IsFunctionLocal = true;
+
   std::vector<ContractGroup> getContract() const { return {}; }
 
   explicit LoadModelPipePass(ModelWrapper Wrapper) :
@@ -400,71 +413,103 @@ PipelineManager::store(llvm::ArrayRef<std::string> StoresOverrides) {
 
 llvm::Expected<TargetInStepSet>
 PipelineManager::invalidateAllPossibleTargets() {
-  TargetInStepSet ResultMap;
   auto Stream = ExplanationLogger.getAsLLVMStream();
   recalculateAllPossibleTargets();
 
+  // Collect all the targets to invalidate, enumerating each container once
+  TargetInStepSet Map;
   Task T(CurrentState.size(), "invalidateAllPossibleTargets");
   for (const auto &Step : CurrentState) {
     T.advance(Step.first(), true);
     if (Step.first() == Runner->begin()->getName())
       continue;
 
-    Task T2(Step.second.size(), "Containers");
+    auto &Containers = getRunner()[Step.first()].containers();
     for (const auto &Container : Step.second) {
-      T2.advance(Container.first(), true);
-
-      for (const auto &Target : Container.second) {
-        auto &Containers = getRunner()[Step.first()].containers();
-        if (not Containers.contains(Container.first()))
-          continue;
+      if (not Containers.contains(Container.first()))
+        continue;
 
-        if (not Containers[Container.first()].enumerate().contains(Target))
-          continue;
+      TargetsList Available = Containers[Container.first()].enumerate();
+      TargetsList ToInvalidate = Container.second.intersect(Available);
+      if (ToInvalidate.empty())
+        continue;
 
+      for (const auto &Target : ToInvalidate) {
         *Stream << "Invalidating: ";
         *Stream << Step.first() << "/" << Container.first() << "/";
         Target.dump(*Stream);
+      }
 
-        TargetInStepSet Map;
-        Map[Step.first()][Container.first()].push_back(Target);
-        if (auto Error = Runner->getInvalidations(Map); Error)
-          return std::move(Error);
-        if (auto Error = Runner->invalidate(Map); Error)
-          return std::move(Error);
-
-        for (const auto &First : Map) {
-          for (const auto &Second : First.second) {
-            *Stream << "\t" << First.first() << " " << Second.first() << " ";
-            Target.dump(*Stream);
-          }
-        }
+      Map[Step.first()][Container.first()].merge(ToInvalidate);
+    }
+  }
 
-        pipeline::merge(ResultMap, Map);
+  // Compute the closure in a single sweep over the steps and remove all the
+  // targets of each container at once
+  if (auto Error = Runner->getInvalidations(Map); Error)
+    return std::move(Error);
+  if (auto Error = Runner->invalidate(Map); Error)
+    return std::move(Error);
+
+  for (const auto &First : Map) {
+    for (const auto &Second : First.second) {
+      for (const auto &Target : Second.second) {
+        *Stream << "\t" << First.first() << " " << Second.first() << " ";
+        Target.dump(*Stream);
       }
     }
   }
 
-  return ResultMap;
+  return Map;
 }
 
 llvm::Error PipelineManager::produceAllPossibleTargets(bool ExpandTargets) {
   recalculateAllPossibleTargets(ExpandTargets);
 
+  // Targets are requested in batches, so that the input containers are cloned
+  // once per batch rather than once per target
   for (const auto &Step : CurrentState) {
+    ContainerToTargetsMap ToProduce;
+    size_t Pending = 0;
+
+    auto Flush = [&]() -> llvm::Error {
+      if (Pending == 0)
+        return llvm::Error::success();
+
+      ContainerToTargetsMap Batch = std::move(ToProduce);
+      ToProduce = ContainerToTargetsMap();
+      Pending = 0;
+      return Runner->run(Step.first(), Batch);
+    };
+
     for (const auto &Container : Step.second) {
-      for (const auto &Target : Container.second) {
-        ContainerToTargetsMap ToProduce;
-        ToProduce.add(Container.first(), Target);
-        ExplanationLogger << Step.first() << "/" << Container.first() << "/";
-        auto Logger = ExplanationLogger.getAsLLVMStream();
-        Target.dump(*Logger);
-        ExplanationLogger << DoLog;
-
-        if (auto Error = Runner->run(Step.first(), ToProduce); Error)
-          return Error;
+      const TargetsList &Targets = Container.second;
+      auto It = Targets.begin();
+      while (It != Targets.end()) {
+        size_t Available = Targets.end() - It;
+        if (ProduceBatchSize != 0)
+          Available = std::min<size_t>(Available, ProduceBatchSize - Pending);
+
+        auto End = It + Available;
+        for (const Target &Target : llvm::make_range(It, End)) {
+          ExplanationLogger << Step.first() << "/" << Container.first() << "/";
+          auto Logger = ExplanationLogger.getAsLLVMStream();
+          Target.dump(*Logger);
+          ExplanationLogger << DoLog;
+        }
+
+        ToProduce[Container.first()].merge(TargetsList::List(It, End));
+        Pending += Available;
+        It = End;
+
+        if (ProduceBatchSize != 0 and Pending >= ProduceBatchSize)
+          if (auto Error = Flush(); Error)
+            return Error;
       }
     }
+
+    if (auto Error = Flush(); Error)
+      return Error;
   }
 
   return llvm::Error::success();
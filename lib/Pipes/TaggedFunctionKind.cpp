@@ -42,7 +42,9 @@ TaggedFunctionKind::symbolToTarget(const llvm::Function &Symbol) const {
 void TaggedFunctionKind::appendAllTargets(const pipeline::Context &Ctx,
                                           pipeline::TargetsList &Out) const {
   const auto &Model = getModelFromContext(Ctx);
+  auto Inserter = Out.batch_insert();
+  Inserter.reserve(Model->Functions().size());
   for (const auto &Function : Model->Functions()) {
-    Out.push_back(Target(Function.Entry().toString(), *this));
+    Inserter.emplace(Function.Entry().toString(), *this);
   }
 }
@@ -5,6 +5,8 @@
 //
 
 #include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/Storage/ReadableFile.h"
 #include "revng/Storage/WritableFile.h"
@@ -23,16 +25,59 @@ public:
   llvm::MemoryBuffer &buffer() override { return *Buffer; };
 };
 
+/// Writes either in place or to a temporary file next to the destination. In
+/// the latter case, the temporary file replaces the destination only upon
+/// commit, so that whoever has mapped the previous version of the file in
+/// memory keeps seeing consistent content.
 class LocalWritableFile : public WritableFile {
 private:
   std::unique_ptr<llvm::raw_fd_ostream> OS;
+  std::string TemporaryPath;
+  std::string Path;
 
 public:
   LocalWritableFile(std::unique_ptr<llvm::raw_fd_ostream> &&OS) :
     OS(std::move(OS)) {}
-  ~LocalWritableFile() override = default;
+
+  LocalWritableFile(std::unique_ptr<llvm::raw_fd_ostream> &&OS,
+                    std::string TemporaryPath,
+                    std::string Path) :
+    OS(std::move(OS)),
+    TemporaryPath(std::move(TemporaryPath)),
+    Path(std::move(Path)) {}
+
+  ~LocalWritableFile() override {
+    if (not TemporaryPath.empty()) {
+      OS->close();
+      OS->clear_error();
+      llvm::sys::fs::remove(TemporaryPath);
+    }
+  }
+
   llvm::raw_pwrite_stream &os() override { return *OS; }
-  llvm::Error commit() override { return llvm::Error::success(); }
+
+  llvm::Error commit() override {
+    if (TemporaryPath.empty())
+      return llvm::Error::success();
+
+    OS->close();
+    if (std::error_code EC = OS->error()) {
+      OS->clear_error();
+      return llvm::createStringError(EC,
+                                     "Could not write file %s",
+                                     Path.c_str());
+    }
+
+    if (std::error_code EC = llvm::sys::fs::rename(TemporaryPath, Path)) {
+      return llvm::createStringError(EC,
+                                     "Could not move %s to %s",
+                                     TemporaryPath.c_str(),
+                                     Path.c_str());
+    }
+
+    TemporaryPath.clear();
+    return llvm::Error::success();
+  }
 };
 
 } // namespace revng
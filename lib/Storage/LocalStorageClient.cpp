@@ -100,10 +100,53 @@ LocalStorageClient::getReadableFile(llvm::StringRef Path) {
   return std::make_unique<LocalReadableFile>(std::move(MaybeBuffer.get()));
 }
 
+/// \return true if \p Path is, or is a symlink to, an existing regular file
+static bool isRegularFile(const std::string &Path) {
+  llvm::sys::fs::file_status Status;
+  if (llvm::sys::fs::status(Path, Status, /* Follow */ true))
+    return false;
+
+  return llvm::sys::fs::is_regular_file(Status);
+}
+
 llvm::Expected<std::unique_ptr<WritableFile>>
 LocalStorageClient::getWritableFile(llvm::StringRef Path,
                                     ContentEncoding Encoding) {
   std::string ResolvedPath = resolvePath(Path);
+
+  // Existing regular files are replaced upon commit, so that whoever has
+  // mapped the previous version in memory keeps seeing consistent content.
+  // Symlinks are preserved, their target is replaced. Writing in place would
+  // truncate a file that might be mapped, so if the temporary file cannot be
+  // created (e.g., the directory is read-only) we fail instead.
+  if (isRegularFile(ResolvedPath)) {
+    llvm::SmallString<128> TargetPath;
+    if (std::error_code EC = llvm::sys::fs::real_path(ResolvedPath,
+                                                      TargetPath)) {
+      return llvm::createStringError(EC,
+                                     "Could not resolve %s",
+                                     ResolvedPath.c_str());
+    }
+
+    int FD = -1;
+    llvm::SmallString<128> TemporaryPath;
+    std::error_code EC = llvm::sys::fs::createUniqueFile(TargetPath
+                                                           + "-%%%%%%.tmp",
+                                                         FD,
+                                                         TemporaryPath);
+    if (EC) {
+      return llvm::createStringError(EC,
+                                     "Could not create a temporary file to "
+                                     "replace %s",
+                                     TargetPath.c_str());
+    }
+
+    auto OS = std::make_unique<llvm::raw_fd_ostream>(FD, true);
+    return std::make_unique<LocalWritableFile>(std::move(OS),
+                                               TemporaryPath.str().str(),
+                                               TargetPath.str().str());
+  }
+
   std::error_code EC;
   auto OS = std::make_unique<llvm::raw_fd_ostream>(ResolvedPath,
                                                    EC,
@@ -4,7 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <string>
+
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Assert.h"
@@ -79,9 +82,10 @@ static void zlibCopyStream(z_stream &Stream,
   OutputOS.flush();
 }
 
-void gzipCompress(llvm::raw_ostream &OutputOS,
-                  llvm::ArrayRef<uint8_t> InputBuffer,
-                  int CompressionLevel) {
+static void gzipCompressImpl(llvm::raw_ostream &OutputOS,
+                             llvm::ArrayRef<uint8_t> InputBuffer,
+                             int CompressionLevel,
+                             gz_header *Header) {
   revng_assert(CompressionLevel >= 1 and CompressionLevel <= 9);
   z_stream Stream = { .zalloc = Z_NULL, .zfree = Z_NULL, .opaque = Z_NULL };
 
@@ -94,11 +98,34 @@ void gzipCompress(llvm::raw_ostream &OutputOS,
                         Strategy);
   revng_assert(RC == Z_OK);
 
+  if (Header != nullptr)
+    revng_assert(deflateSetHeader(&Stream, Header) == Z_OK);
+
   zlibCopyStream<deflate>(Stream, OutputOS, InputBuffer);
 
   revng_assert(deflateEnd(&Stream) == Z_OK);
 }
 
+void gzipCompress(llvm::raw_ostream &OutputOS,
+                  llvm::ArrayRef<uint8_t> InputBuffer,
+                  int CompressionLevel) {
+  gzipCompressImpl(OutputOS, InputBuffer, CompressionLevel, nullptr);
+}
+
+void gzipCompressWithComment(llvm::raw_ostream &OutputOS,
+                             llvm::ArrayRef<uint8_t> InputBuffer,
+                             llvm::StringRef Comment) {
+  revng_assert(not Comment.contains('\0'));
+  std::string Terminated = Comment.str();
+
+  // No extra field nor file name: the comment immediately follows the fixed
+  // part of the header
+  gz_header Header = {};
+  Header.os = 3; // Unix, like the default header of zlib
+  Header.comment = reinterpret_cast<Bytef *>(Terminated.data());
+  gzipCompressImpl(OutputOS, InputBuffer, 3, &Header);
+}
+
 void gzipDecompress(llvm::raw_ostream &OutputOS,
                     llvm::ArrayRef<uint8_t> InputBuffer) {
   z_stream Stream = { .zalloc = Z_NULL, .zfree = Z_NULL, .opaque = Z_NULL };
@@ -10,6 +10,8 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Debug.h"
@@ -140,35 +142,122 @@ static void compressedPadding(llvm::raw_ostream &OS, size_t Size) {
   return gzipCompress(OS, { Buffer.data(), Buffer.size() });
 }
 
+namespace {
+
+/// The gzip streams making up a file in the archive. The data is not present
+/// if it was already compressed.
+struct CompressedMember {
+  std::string Header;
+  std::string Data;
+  std::string Padding;
+};
+
+} // namespace
+
+static CompressedMember compressMember(const revng::ArchiveMember &Member) {
+  CompressedMember Result;
+  size_t Size = Member.UncompressedSize.value_or(Member.Data.size());
+
+  llvm::raw_string_ostream HeaderOS(Result.Header);
+  writeFileHeader(HeaderOS, Member.Name, Size);
+  HeaderOS.flush();
+
+  if (not Member.UncompressedSize.has_value()) {
+    llvm::raw_string_ostream DataOS(Result.Data);
+    gzipCompress(DataOS, Member.Data);
+    DataOS.flush();
+  }
+
+  if (size_t Padding = computePadding(Size); Padding % BlockSize != 0) {
+    llvm::raw_string_ostream PaddingOS(Result.Padding);
+    compressedPadding(PaddingOS, Padding);
+    PaddingOS.flush();
+  }
+
+  return Result;
+}
+
+/// Number of files compressed before writing them out, which bounds the memory
+/// used to hold compressed data
+static constexpr size_t WindowSize = 1024;
+
 namespace revng {
 
-// Append a given file to an archive.
-OffsetDescriptor GzipTarWriter::append(llvm::StringRef Path,
-                                       llvm::ArrayRef<char> Data) {
+std::vector<OffsetDescriptor>
+GzipTarWriter::append(llvm::ArrayRef<ArchiveMember> Members,
+                      unsigned ThreadsCount) {
   revng_assert(OS != nullptr);
-  revng_assert(not Filenames.contains(Path));
 
-  OffsetDescriptor Result = { .Start = OS->tell() };
-  writeFileHeader(*OS, Path, Data.size());
+  std::vector<OffsetDescriptor> Result;
+  Result.reserve(Members.size());
+
+  auto Strategy = llvm::hardware_concurrency(ThreadsCount);
+  bool Parallel = Members.size() > 1 and Strategy.compute_thread_count() > 1;
+  std::optional<llvm::ThreadPool> Pool;
+  if (Parallel)
+    Pool.emplace(Strategy);
+
+  std::vector<CompressedMember> Compressed;
+  for (size_t Start = 0; Start < Members.size(); Start += WindowSize) {
+    auto Window = Members.slice(Start,
+                                std::min(WindowSize, Members.size() - Start));
+
+    Compressed.clear();
+    Compressed.resize(Window.size());
+    for (size_t I = 0; I < Window.size(); ++I) {
+      if (Parallel) {
+        Pool->async([&Compressed, &Window, I]() {
+          Compressed[I] = compressMember(Window[I]);
+        });
+      } else {
+        Compressed[I] = compressMember(Window[I]);
+      }
+    }
+
+    if (Parallel)
+      Pool->wait();
+
+    // Write out the files in order
+    for (size_t I = 0; I < Window.size(); ++I) {
+      const ArchiveMember &Member = Window[I];
+      revng_assert(not Filenames.contains(Member.Name));
+
+      OffsetDescriptor Offsets = { .Start = OS->tell() };
+      *OS << Compressed[I].Header;
+
+      Offsets.DataStart = OS->tell();
+      if (Member.UncompressedSize.has_value())
+        OS->write(Member.Data.data(), Member.Data.size());
+      else
+        *OS << Compressed[I].Data;
 
-  Result.DataStart = OS->tell();
-  gzipCompress(*OS, { Data.data(), Data.size() });
+      Offsets.PaddingStart = OS->tell();
+      *OS << Compressed[I].Padding;
 
-  Result.PaddingStart = OS->tell();
-  if (size_t Padding = computePadding(Data.size()); Padding % BlockSize != 0)
-    compressedPadding(*OS, Padding);
+      Offsets.End = OS->tell();
+      Filenames.insert(Member.Name);
+      Result.push_back(Offsets);
+    }
+  }
 
-  Result.End = OS->tell();
-  Filenames.insert(Path);
   return Result;
 }
 
-void GzipTarWriter::close() {
+size_t GzipTarWriter::close(llvm::StringRef Comment) {
   revng_assert(OS != nullptr);
+  size_t CommentOffset = OS->tell() + GzipCommentOffset;
+
   // The tar archive needs to be ended with two blocks of zeros
-  compressedPadding(*OS, BlockSize * 2);
+  if (Comment.empty()) {
+    compressedPadding(*OS, BlockSize * 2);
+  } else {
+    llvm::SmallVector<uint8_t> Buffer(BlockSize * 2, 0);
+    gzipCompressWithComment(*OS, Buffer, Comment);
+  }
+
   OS->flush();
   OS = nullptr;
+  return CommentOffset;
 }
 
 GzipTarReader::GzipTarReader(llvm::ArrayRef<char> Ref) {
@@ -208,4 +297,29 @@ cppcoro::generator<ArchiveEntry> GzipTarReader::entries() {
   }
 }
 
+std::vector<std::string>
+inflateMembers(llvm::ArrayRef<llvm::ArrayRef<char>> Members,
+               unsigned ThreadsCount) {
+  std::vector<std::string> Result(Members.size());
+  auto Inflate = [&Result, &Members](size_t I) {
+    llvm::raw_string_ostream OS(Result[I]);
+    gzipDecompress(OS, Members[I]);
+    OS.flush();
+  };
+
+  auto Strategy = llvm::hardware_concurrency(ThreadsCount);
+  if (Members.size() <= 1 or Strategy.compute_thread_count() <= 1) {
+    for (size_t I = 0; I < Members.size(); ++I)
+      Inflate(I);
+    return Result;
+  }
+
+  llvm::ThreadPool Pool(Strategy);
+  for (size_t I = 0; I < Members.size(); ++I)
+    Pool.async(Inflate, I);
+  Pool.wait();
+
+  return Result;
+}
+
 } // namespace revng
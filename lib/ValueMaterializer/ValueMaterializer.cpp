@@ -4,12 +4,196 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
+
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/Support/GenericDomTreeConstruction.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/Support/Debug.h"
 #include "revng/ValueMaterializer/ValueMaterializer.h"
 
+FunctionFingerprint::FunctionFingerprint(const llvm::Function &F) : F(&F) {
+  using namespace llvm;
+
+  unsigned UnnamedIndex = 0;
+  for (const BasicBlock &BB : F) {
+    if (BB.hasName())
+      BlockIDs[&BB] = BB.getName().str();
+    else
+      BlockIDs[&BB] = "#" + std::to_string(UnnamedIndex++);
+
+    unsigned Index = 0;
+    for (const Instruction &I : BB)
+      Indices[&I] = Index++;
+  }
+
+  // Hash the instructions only once all the identifiers are available
+  for (const BasicBlock &BB : F) {
+    hash_code Result = hash_value(blockID(&BB));
+    for (const Instruction &I : BB) {
+      hash_code InstructionHash = hashInstruction(&I);
+      InstructionHashes[&I] = static_cast<uint64_t>(InstructionHash);
+      Result = hash_combine(Result, InstructionHash);
+    }
+    BlockHashes[&BB] = static_cast<uint64_t>(Result);
+  }
+}
+
+llvm::StringRef FunctionFingerprint::blockID(const llvm::BasicBlock *BB) const {
+  auto It = BlockIDs.find(BB);
+  revng_assert(It != BlockIDs.end());
+  return It->second;
+}
+
+unsigned FunctionFingerprint::index(const llvm::Instruction *I) const {
+  auto It = Indices.find(I);
+  revng_assert(It != Indices.end());
+  return It->second;
+}
+
+llvm::hash_code FunctionFingerprint::value(const llvm::Value *V) const {
+  using namespace llvm;
+
+  if (auto *I = dyn_cast<Instruction>(V))
+    return hash_combine(I->getOpcode(), blockID(I->getParent()), index(I));
+
+  if (auto *BB = dyn_cast<BasicBlock>(V))
+    return hash_combine(V->getValueID(), blockID(BB));
+
+  if (auto *A = dyn_cast<Argument>(V))
+    return hash_combine(V->getValueID(), A->getArgNo());
+
+  // Global values might be temporary, use their name
+  if (auto *GV = dyn_cast<GlobalValue>(V))
+    return hash_combine(V->getValueID(), GV->getName());
+
+  if (auto *CE = dyn_cast<ConstantExpr>(V)) {
+    hash_code Result = hash_combine(V->getValueID(), CE->getOpcode());
+    for (const Use &Operand : CE->operands())
+      Result = hash_combine(Result, value(Operand.get()));
+    return Result;
+  }
+
+  // Other constants are uniqued and owned by the context
+  return hash_value(V);
+}
+
+uint64_t FunctionFingerprint::instruction(const llvm::Instruction *I) const {
+  auto It = InstructionHashes.find(I);
+  revng_assert(It != InstructionHashes.end());
+  return It->second;
+}
+
+uint64_t FunctionFingerprint::block(const llvm::BasicBlock *BB) const {
+  auto It = BlockHashes.find(BB);
+  revng_assert(It != BlockHashes.end());
+  return It->second;
+}
+
+llvm::hash_code
+FunctionFingerprint::hashInstruction(const llvm::Instruction *I) const {
+  using namespace llvm;
+
+  hash_code Result = hash_combine(value(I), I->getType());
+
+  if (auto *Compare = dyn_cast<CmpInst>(I))
+    Result = hash_combine(Result, Compare->getPredicate());
+
+  for (const Use &Operand : I->operands())
+    Result = hash_combine(Result, value(Operand.get()));
+
+  // The incoming blocks of phis are not operands
+  if (auto *Phi = dyn_cast<PHINode>(I))
+    for (const BasicBlock *Incoming : Phi->blocks())
+      Result = hash_combine(Result, blockID(Incoming));
+
+  return Result;
+}
+
+/// \return the microseconds elapsed since \p Start
+static double microsecondsSince(std::chrono::steady_clock::time_point Start) {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now() - Start).count();
+}
+
+void ValueMaterializerCache::beginRound(const llvm::Function &F) {
+  auto Start = std::chrono::steady_clock::now();
+  Fingerprint.emplace(F);
+  FingerprintTimeStatistics.push(microsecondsSince(Start));
+}
+
 void ValueMaterializer::run() {
+  prepare();
+
+  if (fetchFromCache())
+    return;
+
+  computeOracleConstraints();
+
+  analyze();
+
+  materialize();
+}
+
+std::vector<ValueMaterializer>
+ValueMaterializer::getValuesFor(llvm::ArrayRef<Query> Queries,
+                                MemoryOracle &MO,
+                                llvm::LazyValueInfo &LVI,
+                                const llvm::DominatorTree &DT) {
+  std::vector<ValueMaterializer> Results;
+  Results.reserve(Queries.size());
+  for (const Query &Q : Queries) {
+    Results.push_back(ValueMaterializer(Q.Context,
+                                        Q.V,
+                                        MO,
+                                        LVI,
+                                        DT,
+                                        Q.TheLimits,
+                                        Q.Oracle,
+                                        Q.Cache,
+                                        Q.FastPath));
+  }
+
+  // Go sequential if there's nothing to gain or if we need readable logs
+  auto Strategy = llvm::hardware_concurrency();
+  std::optional<llvm::ThreadPool> Pool;
+  if (Results.size() > 1 and Strategy.compute_thread_count() > 1
+      and not ValueMaterializerLogger.isEnabled()) {
+    Pool.emplace(Strategy);
+  }
+
+  auto RunStage = [&Pool, &Results](void (ValueMaterializer::*Stage)()) {
+    if (not Pool.has_value()) {
+      for (ValueMaterializer &Result : Results)
+        (Result.*Stage)();
+      return;
+    }
+
+    for (ValueMaterializer &Result : Results)
+      Pool->async([&Result, Stage]() { (Result.*Stage)(); });
+    Pool->wait();
+  };
+
+  RunStage(&ValueMaterializer::prepare);
+
+  for (ValueMaterializer &Result : Results)
+    if (not Result.fetchFromCache())
+      Result.computeOracleConstraints();
+
+  RunStage(&ValueMaterializer::analyze);
+
+  for (ValueMaterializer &Result : Results)
+    Result.materialize();
+
+  return Results;
+}
+
+void ValueMaterializer::prepare() {
   revng_log(ValueMaterializerLogger,
             "Evaluating " << getName(V) << " using " << getName(Context)
                           << " as context");
@@ -18,7 +202,6 @@ void ValueMaterializer::run() {
 
   revng_log(ValueMaterializerLogger,
             "The data-flow graph has " << DataFlowGraph.size() << " nodes");
-  DFGSizeStatitistics.push(DataFlowGraph.size());
 
   //
   // Prepare the data-flow graph
@@ -33,15 +216,117 @@ void ValueMaterializer::run() {
 
   DataFlowGraph.purgeUnreachable();
 
-  computeOracleConstraints();
+  if (Cache != nullptr) {
+    // Statistics are not thread-safe, the time is recorded in fetchFromCache
+    auto Start = std::chrono::steady_clock::now();
+    CacheKey = computeCacheKey();
+    CacheKeyTime = microsecondsSince(Start);
+  }
+}
+
+bool ValueMaterializer::fetchFromCache() {
+  DFGSizeStatitistics.push(DataFlowGraph.size());
+
+  if (Cache == nullptr)
+    return false;
+
+  CacheKeyTimeStatistics.push(CacheKeyTime);
+
+  const auto *Cached = Cache->lookup(*CacheKey);
+  if (Cached == nullptr) {
+    DFGCacheStatistics.push("miss");
+    return false;
+  }
+
+  revng_log(ValueMaterializerLogger, "Reusing the results of a previous round");
+  DFGCacheStatistics.push("hit");
+  Values = *Cached;
+  FromCache = true;
+  return true;
+}
+
+void ValueMaterializer::analyze() {
+  if (FromCache)
+    return;
 
   applyOracleResultsToDataFlowGraph();
 
   computeSizeLowerBound();
 
   electMaterializationStartingPoints();
+}
+
+void ValueMaterializer::materialize() {
+  if (FromCache)
+    return;
+
+  if (UsingFastPath)
+    materializeUsingFastPath();
+  else
+    Values = DataFlowGraph.materialize(DataFlowGraph.getEntryNode(), MO);
+
+  if (Cache != nullptr)
+    Cache->insert(*CacheKey, Values);
+}
+
+/// The key captures everything the results depend upon: the query, the
+/// data-flow graph and, if an oracle is employed, all the blocks from which the
+/// context or the instructions of the data-flow graph can be reached. These
+/// are all the blocks LazyValueInfo can inspect, including the terminators
+/// carrying the conditions on the edges towards them.
+///
+/// The code is not hashed here: the hashes computed by
+/// ValueMaterializerCache::beginRound are combined instead.
+ValueMaterializerCache::Key ValueMaterializer::computeCacheKey() const {
+  using namespace llvm;
+
+  const FunctionFingerprint &Hashes = Cache->fingerprint();
+  BasicBlock *ContextBB = Context->getParent();
+  revng_assert(&Hashes.function() == ContextBB->getParent());
+
+  hash_code Result = hash_combine(TheLimits.maxPhiLike(),
+                                  TheLimits.maxLoad(),
+                                  Oracle,
+                                  FastPath,
+                                  Hashes.value(V));
+
+  // Hash the data-flow graph
+  SmallPtrSet<BasicBlock *, 16> InstructionBlocks;
+  for (const DataFlowGraph::Node *Node : DataFlowGraph.nodes()) {
+    Result = hash_combine(Result, Hashes.value(Node->Value));
+
+    if (auto *I = dyn_cast<Instruction>(Node->Value)) {
+      Result = hash_combine(Result, Hashes.instruction(I));
+      InstructionBlocks.insert(I->getParent());
+    }
 
-  Values = DataFlowGraph.materialize(DataFlowGraph.getEntryNode(), MO);
+    for (const DataFlowGraph::Node *Successor : Node->successors())
+      Result = hash_combine(Result, Hashes.value(Successor->Value));
+  }
+
+  // Hash the code considered by the oracle
+  if (Oracle != Oracle::None) {
+    df_iterator_default_set<BasicBlock *> Region;
+    for (BasicBlock *BB : inverse_depth_first_ext(ContextBB, Region))
+      (void) BB;
+    for (BasicBlock *Start : InstructionBlocks)
+      for (BasicBlock *BB : inverse_depth_first_ext(Start, Region))
+        (void) BB;
+
+    // Ignore the order in which we visit the blocks: each hash covers the
+    // identifier of its block, so a sum cannot confuse different regions
+    // unless the hashes collide
+    uint64_t RegionHash = 0;
+    for (BasicBlock *BB : Region)
+      RegionHash += Hashes.block(BB);
+
+    Result = hash_combine(Result, Region.size(), RegionHash);
+  }
+
+  std::string Position = Hashes.blockID(ContextBB).str() + ":"
+                         + std::to_string(Hashes.index(Context));
+
+  return { std::move(Position), static_cast<uint64_t>(Result) };
 }
 
 void ValueMaterializer::computeOracleConstraints() {
@@ -59,9 +344,10 @@ void ValueMaterializer::computeOracleConstraints() {
     break;
 
   case Oracle::AdvancedValueInfo:
-    std::tie(OracleConstraints,
-             CFEG,
-             MFIResults) = runAVI(DataFlowGraph, Context, DT, LVI, true);
+    if (FastPath != FastPath::Disabled and computeDominatingConstraints())
+      UsingFastPath = true;
+    else
+      runAdvancedValueInfo();
     break;
 
   default:
@@ -69,6 +355,119 @@ void ValueMaterializer::computeOracleConstraints() {
   }
 }
 
+void ValueMaterializer::runAdvancedValueInfo() {
+  std::tie(OracleConstraints,
+           CFEG,
+           MFIResults) = runAVI(DataFlowGraph, Context, DT, LVI, true);
+}
+
+bool ValueMaterializer::computeDominatingConstraints() {
+  using namespace llvm;
+
+  SmallPtrSet<Instruction *, 8> Targets;
+  for (DataFlowGraph::Node *Node : DataFlowGraph.nodes())
+    if (auto *I = dyn_cast<Instruction>(Node->Value))
+      if (I->getType()->isIntegerTy())
+        Targets.insert(I);
+
+  // Walk up the dominator tree looking for edges leaving a conditional branch
+  // that dominate the context. For the edge Source -> Destination to dominate
+  // the context it is sufficient that Destination dominates the context and
+  // that Source is its only predecessor.
+  bool Result = false;
+  for (auto *DTNode = DT.getNode(Context->getParent()); DTNode != nullptr;
+       DTNode = DTNode->getIDom()) {
+    BasicBlock *Destination = DTNode->getBlock();
+    BasicBlock *Source = Destination->getSinglePredecessor();
+    if (Source == nullptr)
+      continue;
+
+    auto *Branch = dyn_cast<BranchInst>(Source->getTerminator());
+    if (Branch == nullptr or Branch->isUnconditional()
+        or Branch->getSuccessor(0) == Branch->getSuccessor(1))
+      continue;
+
+    auto *Compare = dyn_cast<ICmpInst>(Branch->getCondition());
+    if (Compare == nullptr)
+      continue;
+
+    auto *Compared = dyn_cast<Instruction>(Compare->getOperand(0));
+    auto *Bound = dyn_cast<ConstantInt>(Compare->getOperand(1));
+    if (Compared == nullptr or Bound == nullptr
+        or not Targets.contains(Compared))
+      continue;
+
+    CmpInst::Predicate Predicate = Compare->getPredicate();
+    if (Branch->getSuccessor(1) == Destination)
+      Predicate = CmpInst::getInversePredicate(Predicate);
+
+    using CR = ConstantRange;
+    ConstantRangeSet Constraint(CR::makeExactICmpRegion(Predicate,
+                                                        Bound->getValue()));
+
+    revng_log(ValueMaterializerLogger,
+              "The edge " << getName(Source) << " -> " << getName(Destination)
+                          << " constrains " << getName(Compared));
+
+    auto It = OracleConstraints.find(Compared);
+    if (It != OracleConstraints.end())
+      It->second = It->second.intersectWith(Constraint);
+    else
+      OracleConstraints[Compared] = Constraint;
+
+    Result = true;
+  }
+
+  return Result;
+}
+
+void ValueMaterializer::materializeUsingFastPath() {
+  DataFlowGraph::Node *Entry = DataFlowGraph.getEntryNode();
+
+  // Do not even try if some of the values are clearly unbounded
+  std::optional<MaterializedValues> FastPathValues;
+  if (Entry->SizeLowerBound != DataFlowNode::MaxSizeLowerBound)
+    FastPathValues = DataFlowGraph.materialize(Entry, MO);
+
+  bool Success = FastPathValues.has_value() and FastPathValues->size() != 0;
+  if (Success and FastPath == FastPath::Enabled) {
+    FastPathStatistics.push("hit");
+    Values = std::move(FastPathValues);
+    return;
+  }
+
+  // Fall back to AdvancedValueInfo
+  resetAnalysis();
+  runAdvancedValueInfo();
+  analyze();
+  Values = DataFlowGraph.materialize(Entry, MO);
+
+  if (not Success) {
+    FastPathStatistics.push("fallback");
+    return;
+  }
+
+  if (Values == FastPathValues) {
+    FastPathStatistics.push("verified");
+  } else {
+    FastPathStatistics.push("mismatch");
+    revng_log(ValueMaterializerLogger,
+              "The fast path and AdvancedValueInfo disagree on the values of "
+                << getName(V));
+  }
+}
+
+void ValueMaterializer::resetAnalysis() {
+  OracleConstraints.clear();
+  UsingFastPath = false;
+
+  for (DataFlowGraph::Node *Node : DataFlowGraph.nodes()) {
+    Node->OracleRange.reset();
+    Node->SizeLowerBound = 1;
+    Node->UseOracle = false;
+  }
+}
+
 void ValueMaterializer::applyOracleResultsToDataFlowGraph() {
   using namespace llvm;
   const DataLayout &DL = getModule(Context)->getDataLayout();
@@ -173,6 +173,14 @@ void revng::Tracking::pop(const /*= base_namespace =*/::/*= struct.name =*/ &LHS
 template
 void revng::Tracking::stop(const /*= base_namespace =*/::/*= struct.name =*/ &LHS);
 
+/** if struct.name == root_type **/
+template
+void startWriteTracking(const /*= base_namespace =*/::/*= root_type =*/ &Root, /*= base_namespace =*/::/*= root_type =*/ &Baseline);
+
+template
+TupleTreeDiff</*= base_namespace =*/::/*= root_type =*/> diffWrites(const /*= base_namespace =*/::/*= root_type =*/ &Root, const /*= base_namespace =*/::/*= root_type =*/ &Baseline);
+/** endif **/
+
 /** endif **/
 
 /**- for field in struct.fields **/
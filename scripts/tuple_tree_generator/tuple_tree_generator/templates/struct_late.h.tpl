@@ -281,4 +281,12 @@ void revng::Tracking::pop(const /*= base_namespace =*/::/*= struct.name =*/ &LHS
 extern template
 void revng::Tracking::stop(const /*= base_namespace =*/::/*= struct.name =*/ &LHS);
 
+/** if struct.name == root_type **/
+extern template
+void startWriteTracking(const /*= base_namespace =*/::/*= root_type =*/ &Root, /*= base_namespace =*/::/*= root_type =*/ &Baseline);
+
+extern template
+TupleTreeDiff</*= base_namespace =*/::/*= root_type =*/> diffWrites(const /*= base_namespace =*/::/*= root_type =*/ &Root, const /*= base_namespace =*/::/*= root_type =*/ &Baseline);
+/** endif **/
+
 /** endif **/
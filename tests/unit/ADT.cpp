@@ -4,15 +4,137 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
 #define BOOST_TEST_MODULE RegisterUsageAnalyses
 bool init_unit_test();
 #include "boost/test/unit_test.hpp"
 
+#include "llvm/Support/ThreadPool.h"
+
+#include "revng/ADT/BatchedFixedPoint.h"
 #include "revng/ADT/CompilationTime.h"
 #include "revng/ADT/Concepts.h"
 #include "revng/ADT/ConstexprString.h"
 #include "revng/ADT/STLExtras.h"
 
+//
+// BatchedFixedPoint.h
+//
+
+namespace {
+
+/// A toy interprocedural analysis: the summary of a function is the set of
+/// registers it uses, either directly or through its callees
+class CallGraphFixedPoint {
+private:
+  std::vector<uint64_t> Uses;
+  std::vector<std::vector<unsigned>> Callees;
+  std::vector<std::vector<unsigned>> Callers;
+  std::vector<std::set<unsigned>> Footprints;
+
+public:
+  std::vector<uint64_t> Summaries;
+  std::vector<unsigned> CommitOrder;
+
+public:
+  CallGraphFixedPoint(std::vector<uint64_t> Uses,
+                      std::vector<std::pair<unsigned, unsigned>> Calls) :
+    Uses(Uses),
+    Callees(Uses.size()),
+    Callers(Uses.size()),
+    Footprints(Uses.size()),
+    Summaries(Uses.size(), 0) {
+    for (unsigned Index = 0; Index < Uses.size(); ++Index)
+      Footprints[Index].insert(Index);
+
+    for (auto [Caller, Callee] : Calls) {
+      Callees[Caller].push_back(Callee);
+      Callers[Callee].push_back(Caller);
+      Footprints[Caller].insert(Callee);
+    }
+  }
+
+public:
+  void run(llvm::ThreadPool *Pool, size_t MaxBatchSize) {
+    UniquedQueue<unsigned> Queue;
+    for (unsigned Index = 0; Index < Uses.size(); ++Index)
+      Queue.insert(Index);
+
+    auto Footprint = [this](unsigned Function) -> const auto & {
+      return Footprints[Function];
+    };
+
+    auto Prepare = [](unsigned Function) { return Function; };
+
+    auto Analyze = [this](unsigned Function) {
+      uint64_t Result = Uses[Function];
+      for (unsigned Callee : Callees[Function])
+        Result |= Summaries[Callee];
+      return Result;
+    };
+
+    auto Commit = [this, &Queue](llvm::ArrayRef<unsigned> Batch,
+                                 llvm::MutableArrayRef<uint64_t> Results) {
+      for (size_t Index = 0; Index < Batch.size(); ++Index) {
+        unsigned Function = Batch[Index];
+        CommitOrder.push_back(Function);
+        if (Summaries[Function] == Results[Index])
+          continue;
+
+        Summaries[Function] = Results[Index];
+        for (unsigned Caller : Callers[Function])
+          Queue.insert(Caller);
+      }
+    };
+
+    runBatchedFixedPoint(Queue,
+                         Pool,
+                         MaxBatchSize,
+                         Footprint,
+                         Prepare,
+                         Analyze,
+                         Commit);
+  }
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(BatchedFixedPointDoesNotDependOnThreads) {
+  // Two recursive components, a shared leaf and a function calling itself
+  std::vector<uint64_t> Uses = { 1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 4,
+                                 1 << 5, 1 << 6, 1 << 7, 1 << 8, 1 << 9 };
+  std::vector<std::pair<unsigned, unsigned>> Calls = {
+    { 0, 1 }, { 1, 2 }, { 2, 0 }, { 2, 9 }, { 3, 4 }, { 4, 5 }, { 5, 3 },
+    { 5, 9 }, { 6, 0 }, { 6, 3 }, { 7, 7 }, { 7, 6 }, { 8, 9 }
+  };
+
+  CallGraphFixedPoint Sequential(Uses, Calls);
+  Sequential.run(nullptr, 1);
+
+  // Sanity check the fixed point itself
+  revng_check(Sequential.Summaries[9] == 1 << 9);
+  revng_check(Sequential.Summaries[0] == 0b1000000111);
+  revng_check(Sequential.Summaries[7] == 0b1011111111);
+
+  for (size_t MaxBatchSize : { 1, 3, 16 }) {
+    CallGraphFixedPoint Batched(Uses, Calls);
+    Batched.run(nullptr, MaxBatchSize);
+    revng_check(Batched.Summaries == Sequential.Summaries);
+
+    for (unsigned Threads : { 1, 2, 4 }) {
+      llvm::ThreadPool Pool(llvm::hardware_concurrency(Threads));
+      CallGraphFixedPoint Parallel(Uses, Calls);
+      Parallel.run(&Pool, MaxBatchSize);
+      revng_check(Parallel.Summaries == Batched.Summaries);
+      revng_check(Parallel.CommitOrder == Batched.CommitOrder);
+    }
+  }
+}
+
 //
 // CompilationTime.h
 //
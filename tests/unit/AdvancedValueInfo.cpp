@@ -26,14 +26,17 @@ using namespace llvm;
 class MockupMemoryOracle final : public MemoryOracle {
 private:
   const llvm::DataLayout &DL;
+  unsigned LoadsCount = 0;
 
 public:
   MockupMemoryOracle(const llvm::DataLayout &DL) : DL(DL) {}
   ~MockupMemoryOracle() final = default;
 
   const llvm::DataLayout &getDataLayout() const { return DL; }
+  unsigned loadsCount() const { return LoadsCount; }
 
   MaterializedValue load(uint64_t LoadAddress, unsigned LoadSize) final {
+    ++LoadsCount;
     if (LoadAddress == 1000)
       return MaterializedValue::fromSymbol("symbol", APInt(LoadSize * 8, 0));
     return MaterializedValue::fromConstant(APInt(LoadSize * 8, 42));
@@ -49,8 +52,15 @@ public:
 
 public:
   TestAdvancedValueInfoPass() : ModulePass(ID), Results(nullptr) {}
-  TestAdvancedValueInfoPass(ResultsMap &Results) :
-    ModulePass(ID), Results(&Results) {}
+  TestAdvancedValueInfoPass(ResultsMap &Results,
+                            ValueMaterializerCache *Cache = nullptr,
+                            unsigned *LoadsCount = nullptr,
+                            FastPath::Values FastPath = FastPath::Disabled) :
+    ModulePass(ID),
+    Results(&Results),
+    Cache(Cache),
+    LoadsCount(LoadsCount),
+    FastPath(FastPath) {}
 
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.setPreservesAll();
@@ -62,6 +72,9 @@ public:
 
 private:
   ResultsMap *Results;
+  ValueMaterializerCache *Cache = nullptr;
+  unsigned *LoadsCount = nullptr;
+  FastPath::Values FastPath = FastPath::Disabled;
 };
 
 char TestAdvancedValueInfoPass::ID = 0;
@@ -82,6 +95,9 @@ bool TestAdvancedValueInfoPass::runOnModule(llvm::Module &M) {
 
   MockupMemoryOracle MO(M.getDataLayout());
 
+  if (Cache != nullptr)
+    Cache->beginRound(Root);
+
   for (User *U : M.getGlobalVariable("pc", true)->users()) {
     if (auto *Store = dyn_cast<StoreInst>(U)) {
       Value *V = Store->getValueOperand();
@@ -93,7 +109,9 @@ bool TestAdvancedValueInfoPass::runOnModule(llvm::Module &M) {
                                                       LVI,
                                                       DT,
                                                       {},
-                                                      Oracle::AdvancedValueInfo)
+                                                      Oracle::AdvancedValueInfo,
+                                                      Cache,
+                                                      FastPath)
                         .values();
       if (MaybeValues) {
         (*Results)[V] = *MaybeValues;
@@ -101,12 +119,45 @@ bool TestAdvancedValueInfoPass::runOnModule(llvm::Module &M) {
     }
   }
 
+  if (LoadsCount != nullptr)
+    *LoadsCount = MO.loadsCount();
+
+  // Processing all the stores at once must lead to the same results
+  if (Cache == nullptr) {
+    std::vector<ValueMaterializer::Query> Queries;
+    for (User *U : M.getGlobalVariable("pc", true)->users()) {
+      if (auto *Store = dyn_cast<StoreInst>(U)) {
+        Queries.push_back({ Store,
+                            Store->getValueOperand(),
+                            {},
+                            Oracle::AdvancedValueInfo,
+                            nullptr,
+                            FastPath });
+      }
+    }
+
+    auto AllResults = ValueMaterializer::getValuesFor(Queries, MO, LVI, DT);
+    revng_check(AllResults.size() == Queries.size());
+    for (size_t Index = 0; Index < Queries.size(); ++Index) {
+      const auto &MaybeValues = AllResults[Index].values();
+      Value *V = Queries[Index].V;
+      if (MaybeValues)
+        revng_check(Results->at(V) == *MaybeValues);
+      else
+        revng_check(Results->count(V) == 0);
+    }
+  }
+
   return false;
 }
 
 using CheckMap = std::map<const char *, MaterializedValues>;
 
-static void checkAdvancedValueInfo(const char *Body, const CheckMap &Map) {
+static void
+checkAdvancedValueInfo(const char *Body,
+                       const CheckMap &Map,
+                       FastPath::Values FastPath = FastPath::Disabled,
+                       ValueMaterializerCache *Cache = nullptr) {
   auto &Registry = *PassRegistry::getPassRegistry();
   initializeDominatorTreeWrapperPassPass(Registry);
   initializeLazyValueInfoWrapperPassPass(Registry);
@@ -120,7 +171,7 @@ static void checkAdvancedValueInfo(const char *Body, const CheckMap &Map) {
 
   legacy::PassManager PM;
   PM.add(createLazyValueInfoPass());
-  PM.add(new TestAdvancedValueInfoPass(Results));
+  PM.add(new TestAdvancedValueInfoPass(Results, Cache, nullptr, FastPath));
   PM.run(*M);
 
   TestAdvancedValueInfoPass::ResultsMap Reference;
@@ -511,3 +562,148 @@ end:
                                aI64(33),
                                aI64(34) } } });
 }
+
+BOOST_AUTO_TEST_CASE(TestMultipleQueries) {
+  checkAdvancedValueInfo(R"LLVM(
+  %original = load i64, i64 *@pc
+  %cmp = icmp ult i64 %original, 3
+  br i1 %cmp, label %smaller, label %other
+
+smaller:
+  %shifted = shl i64 %original, 1
+  store i64 %shifted, i64* @pc
+  br label %other
+
+other:
+  %fortytwo = load i64, i64* inttoptr (i64 4294967296 to i64*)
+  %to_store = add i64 %fortytwo, 1
+  store i64 %to_store, i64* @pc
+  br label %last
+
+last:
+  %constant = add i64 4194424, 0
+  store i64 %constant, i64* @pc
+  unreachable
+
+)LLVM",
+                         { { "shifted", { aI64(0), aI64(2), aI64(4) } },
+                           { "to_store", { aI64(43) } },
+                           { "constant", { aI64(4194424) } } });
+}
+
+BOOST_AUTO_TEST_CASE(TestFastPath) {
+  const char *JumpTable = R"LLVM(
+  %index = load i64, i64* @rax
+  %out_of_bounds = icmp ugt i64 %index, 3
+  br i1 %out_of_bounds, label %default, label %table
+
+table:
+  %offset = shl i64 %index, 3
+  %address = add i64 %offset, 1000
+  %pointer = inttoptr i64 %address to i64*
+  %to_store = load i64, i64* %pointer
+  store i64 %to_store, i64* @pc
+  unreachable
+
+default:
+  unreachable
+
+)LLVM";
+
+  CheckMap Expected{ { "to_store",
+                       { MaterializedValue::fromSymbol("symbol", APInt(64, 0)),
+                         aI64(42) } } };
+
+  for (FastPath::Values Mode : { FastPath::Enabled, FastPath::Verify })
+    checkAdvancedValueInfo(JumpTable, Expected, Mode);
+}
+
+/// \return the number of loads from memory performed to materialize the
+///         values stored in the program counter
+static unsigned materializeWithCache(LLVMContext &C,
+                                     const char *Body,
+                                     ValueMaterializerCache &Cache,
+                                     const MaterializedValues &Expected) {
+  auto &Registry = *PassRegistry::getPassRegistry();
+  initializeDominatorTreeWrapperPassPass(Registry);
+  initializeLazyValueInfoWrapperPassPass(Registry);
+
+  std::unique_ptr<llvm::Module> M = loadModule(C, Body);
+
+  TestAdvancedValueInfoPass::ResultsMap Results;
+  unsigned LoadsCount = 0;
+
+  legacy::PassManager PM;
+  PM.add(createLazyValueInfoPass());
+  PM.add(new TestAdvancedValueInfoPass(Results, &Cache, &LoadsCount));
+  PM.run(*M);
+
+  revng_check(Results.size() == 1);
+  revng_check(Results.begin()->second == Expected);
+
+  Cache.endRound();
+
+  return LoadsCount;
+}
+
+BOOST_AUTO_TEST_CASE(TestCache) {
+  const char *Original = R"LLVM(
+  %fortytwo = load i64, i64* inttoptr (i64 4294967296 to i64*)
+  %to_store = add i64 %fortytwo, 1
+  store i64 %to_store, i64* @pc
+  unreachable
+
+)LLVM";
+
+  const char *Changed = R"LLVM(
+  %fortytwo = load i64, i64* inttoptr (i64 4294967296 to i64*)
+  %to_store = add i64 %fortytwo, 2
+  store i64 %to_store, i64* @pc
+  unreachable
+
+)LLVM";
+
+  // The cache relies on the constants being uniqued in the context
+  LLVMContext C;
+  ValueMaterializerCache Cache;
+
+  // Nothing is cached yet
+  BOOST_TEST(materializeWithCache(C, Original, Cache, { aI64(43) }) != 0U);
+
+  // A copy of the same code reuses the previous results
+  BOOST_TEST(materializeWithCache(C, Original, Cache, { aI64(43) }) == 0U);
+
+  // Changing the code invalidates the results
+  BOOST_TEST(materializeWithCache(C, Changed, Cache, { aI64(44) }) != 0U);
+}
+
+BOOST_AUTO_TEST_CASE(TestCacheUnnamedBlocks) {
+  // The two unnamed blocks have the same content, but different constraints
+  // on the stored value
+  const char *Body = R"LLVM(
+  %original = load i64, i64 *@pc
+  %masked = and i64 %original, 7
+  %cmp = icmp ult i64 %masked, 5
+  br i1 %cmp, label %0, label %1
+
+0:
+  %smaller = add i64 %masked, 1
+  store i64 %smaller, i64* @pc
+  unreachable
+
+1:
+  %greater = add i64 %masked, 1
+  store i64 %greater, i64* @pc
+  unreachable
+
+)LLVM";
+
+  CheckMap Expected{
+    { "smaller", { aI64(1), aI64(2), aI64(3), aI64(4), aI64(5) } },
+    { "greater", { aI64(6), aI64(7), aI64(8) } }
+  };
+
+  // The second query must not be served the results of the first one
+  ValueMaterializerCache Cache;
+  checkAdvancedValueInfo(Body, Expected, FastPath::Disabled, &Cache);
+}
@@ -68,3 +68,91 @@ BOOST_AUTO_TEST_CASE(GzipTarFileTest) {
   checkOffset(Buffer, Offset1.DataStart, Offset1.dataSize(), "foo2");
   checkOffset(Buffer, Offset2.DataStart, Offset2.dataSize(), "bar2");
 }
+
+BOOST_AUTO_TEST_CASE(GzipTarFileAppendCompressedTest) {
+  using revng::ArchiveEntry;
+  using revng::OffsetDescriptor;
+
+  llvm::SmallVector<char> Source;
+  llvm::raw_svector_ostream SourceOS(Source);
+  revng::GzipTarWriter SourceWriter(SourceOS);
+  const char Data[5] = "foo2";
+  OffsetDescriptor SourceOffset = SourceWriter.append("foo", { Data, 4 });
+  SourceWriter.close();
+
+  // Copy the compressed data of the file to a new archive
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  revng::GzipTarWriter Writer(OS);
+  llvm::ArrayRef<char> Compressed(Source.data() + SourceOffset.DataStart,
+                                  SourceOffset.dataSize());
+  OffsetDescriptor Offset = Writer.appendCompressed("bar", 4, Compressed);
+  Writer.close();
+
+  {
+    revng::GzipTarReader Reader({ Buffer.data(), Buffer.size() });
+
+    cppcoro::generator<ArchiveEntry> Gen = Reader.entries();
+    std::vector<ArchiveEntry> Entries(Gen.begin(), Gen.end());
+    BOOST_TEST(Entries.size() == 1ULL);
+
+    llvm::StringRef RefData(Entries[0].Data.data(), Entries[0].Data.size());
+    BOOST_TEST(Entries[0].Filename == "bar");
+    BOOST_TEST(RefData.str() == "foo2");
+  }
+
+  checkOffset(Buffer, Offset.DataStart, Offset.dataSize(), "foo2");
+}
+
+BOOST_AUTO_TEST_CASE(GzipTarFileParallelTest) {
+  using revng::ArchiveMember;
+  using revng::OffsetDescriptor;
+
+  std::vector<std::string> Names;
+  std::vector<std::string> Contents;
+  for (size_t I = 0; I < 3000; ++I) {
+    Names.push_back("file" + std::to_string(I));
+    Contents.push_back(std::string(I, static_cast<char>('a' + I % 26)));
+  }
+
+  std::vector<ArchiveMember> Members;
+  for (size_t I = 0; I < Names.size(); ++I)
+    Members.push_back({ .Name = Names[I],
+                        .Data = { Contents[I].data(), Contents[I].size() } });
+
+  // Appending in parallel must produce the same archive as appending
+  // sequentially
+  llvm::SmallVector<char> Sequential;
+  llvm::raw_svector_ostream SequentialOS(Sequential);
+  revng::GzipTarWriter SequentialWriter(SequentialOS);
+  std::vector<OffsetDescriptor> SequentialOffsets;
+  for (const ArchiveMember &Member : Members)
+    SequentialOffsets.push_back(SequentialWriter.append(Member.Name,
+                                                        Member.Data));
+  SequentialWriter.close();
+
+  llvm::SmallVector<char> Parallel;
+  llvm::raw_svector_ostream ParallelOS(Parallel);
+  revng::GzipTarWriter ParallelWriter(ParallelOS);
+  std::vector<OffsetDescriptor> ParallelOffsets = ParallelWriter.append(Members,
+                                                                        4);
+  ParallelWriter.close();
+
+  BOOST_TEST((Sequential == Parallel));
+  BOOST_TEST(SequentialOffsets.size() == ParallelOffsets.size());
+
+  std::vector<llvm::ArrayRef<char>> Compressed;
+  for (size_t I = 0; I < ParallelOffsets.size(); ++I) {
+    const OffsetDescriptor &Expected = SequentialOffsets[I];
+    OffsetDescriptor &Offset = ParallelOffsets[I];
+    BOOST_TEST(Expected.Start == Offset.Start);
+    BOOST_TEST(Expected.DataStart == Offset.DataStart);
+    BOOST_TEST(Expected.PaddingStart == Offset.PaddingStart);
+    BOOST_TEST(Expected.End == Offset.End);
+    Compressed.emplace_back(Parallel.data() + Offset.DataStart,
+                            Offset.dataSize());
+  }
+
+  std::vector<std::string> Inflated = revng::inflateMembers(Compressed, 4);
+  BOOST_TEST((Inflated == Contents));
+}
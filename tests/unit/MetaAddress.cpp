@@ -11,6 +11,8 @@ bool init_unit_test();
 #include "boost/test/execution_monitor.hpp"
 #include "boost/test/unit_test.hpp"
 
+#include "llvm/ADT/DenseMap.h"
+
 #include "revng/Support/MetaAddress.h"
 #include "revng/UnitTestHelpers/UnitTestHelpers.h"
 
@@ -183,3 +185,22 @@ BOOST_AUTO_TEST_CASE(Map) {
 
   BOOST_TEST(Map.size() == size_t(5));
 }
+
+BOOST_AUTO_TEST_CASE(DenseMap) {
+  llvm::DenseMap<MetaAddress, int> Map;
+
+  Map[generic64(0)] = 1;
+  Map[MetaAddress::invalid()] = 1;
+  Map[pc(0)] = 1;
+  Map[MetaAddress::fromPC(Triple::arm, 0)] = 1;
+  Map[MetaAddress::fromPC(Triple::arm, 1)] = 1;
+  Map[generic64(0)] = 2;
+
+  BOOST_TEST(Map.size() == size_t(5));
+  BOOST_TEST(Map.lookup(generic64(0)) == 2);
+  BOOST_TEST(Map.count(generic32(0)) == size_t(0));
+
+  Map.erase(pc(0));
+  BOOST_TEST(Map.size() == size_t(4));
+  BOOST_TEST(Map.count(MetaAddress::invalid()) == size_t(1));
+}
@@ -4,6 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <random>
+#include <utility>
+
 #define BOOST_TEST_MODULE Model
 bool init_unit_test();
 #include "boost/test/unit_test.hpp"
@@ -11,6 +14,8 @@ bool init_unit_test();
 #include "revng/Model/Binary.h"
 #include "revng/Model/Pass/AllPasses.h"
 #include "revng/Model/Processing.h"
+#include "revng/Model/RawBinaryView.h"
+#include "revng/Pipeline/Global.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/MetaAddress/YAMLTraits.h"
 #include "revng/Support/YAMLTraits.h"
@@ -18,6 +23,7 @@ bool init_unit_test();
 #include "revng/TupleTree/Introspection.h"
 #include "revng/TupleTree/Tracking.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
+#include "revng/TupleTree/TupleTreeHash.h"
 #include "revng/TupleTree/VisitsImpl.h"
 #include "revng/UnitTestHelpers/UnitTestHelpers.h"
 
@@ -439,3 +445,291 @@ BOOST_AUTO_TEST_CASE(QualifiersInsideAVectorAreNotVisited) {
   };
   BOOST_TEST(Collected.Read == Paths);
 }
+
+static std::string toString(const TupleTreeDiff<model::Binary> &Diff) {
+  std::string Result;
+  llvm::raw_string_ostream Stream(Result);
+  serialize(Stream, Diff);
+  Stream.flush();
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(DiffWritesShouldMatchFullDiff) {
+  model::Binary Model;
+  const auto Address = MetaAddress::fromPC(llvm::Triple::ArchType::x86_64,
+                                           0x1000);
+  const auto Other = MetaAddress::fromPC(llvm::Triple::ArchType::x86_64,
+                                         0x2000);
+  Model.Segments().insert(Segment(Address, 1000));
+  Model.Segments().insert(Segment(Other, 1000));
+  Model.ExtraCodeAddresses().insert(Address);
+  Model.ImportedLibraries().insert("libc.so.6");
+  const model::Binary Before = Model;
+
+  model::Binary Baseline;
+  startWriteTracking(Model, Baseline);
+
+  // Modify an element, remove another one and add a new one
+  Model.Segments().at(Segment::Key(Address, 1000)).CustomName() = "text";
+  Model.Segments().erase(Segment::Key(Other, 1000));
+  Model.Segments().insert(Segment(Other, 2000));
+
+  // Replace the entire content of a container
+  Model.ExtraCodeAddresses().clear();
+  Model.ExtraCodeAddresses().insert(Other);
+
+  // Modify a field that is not a container
+  Model.EntryPoint() = Address;
+
+  auto Writes = diffWrites(Model, Baseline);
+  BOOST_TEST(Writes.Changes.size() != 0);
+  BOOST_TEST(toString(Writes) == toString(diff(Before, Model)));
+}
+
+BOOST_AUTO_TEST_CASE(WritesThroughReferencesShouldBeTracked) {
+  pipeline::TupleTreeGlobal<model::Binary> Global("model.yml");
+  TupleTree<model::Binary> &Tree = Global.get();
+  auto *Target = createType<TypedefType>(*Tree);
+  auto Generic32 = Tree->getPrimitiveType(PrimitiveTypeKind::Generic, 4);
+  Target->UnderlyingType() = { Generic32, {} };
+  auto *Referrer = createType<TypedefType>(*Tree);
+  Referrer->UnderlyingType() = { Tree->getTypePath(Target), {} };
+  model::TypePath &Reference = Referrer->UnderlyingType().UnqualifiedType();
+
+  // References cached before the session started
+  {
+    const model::Binary Before = *std::as_const(Tree);
+    Tree.cacheReferences();
+
+    Global.startWriteTracking();
+    Reference.get()->OriginalName() = "Renamed";
+    auto Writes = Global.collectWrites();
+
+    const auto &After = *std::as_const(Tree);
+    BOOST_TEST(Writes.getAs<model::Binary>()->Changes.size() != 0);
+    BOOST_TEST(toString(*Writes.getAs<model::Binary>())
+               == toString(diff(Before, After)));
+  }
+
+  // References cached while the session is in progress
+  {
+    Tree.evictCachedReferences();
+    const model::Binary Before = *std::as_const(Tree);
+
+    Global.startWriteTracking();
+    Tree.cacheReferences();
+    Reference.get()->OriginalName() = "RenamedAgain";
+    auto Writes = Global.collectWrites();
+
+    const auto &After = *std::as_const(Tree);
+    BOOST_TEST(Writes.getAs<model::Binary>()->Changes.size() != 0);
+    BOOST_TEST(toString(*Writes.getAs<model::Binary>())
+               == toString(diff(Before, After)));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MutableAccessesShouldRecordSingleElements) {
+  model::Binary Model;
+  auto AddressAt = [](uint64_t Address) {
+    return MetaAddress::fromPC(llvm::Triple::ArchType::x86_64, Address);
+  };
+  Model.Functions().insert(Function(AddressAt(0x1000)));
+  Model.Functions().insert(Function(AddressAt(0x2000)));
+  Model.Functions().insert(Function(AddressAt(0x3000)));
+  auto &Functions = Model.Functions();
+
+  // Through find
+  Functions.startWriteTracking();
+  Functions.find(AddressAt(0x2000))->CustomName() = "found";
+  auto FindLog = Functions.stopWriteTracking();
+  BOOST_TEST(not FindLog.WholeContent.has_value());
+  BOOST_TEST(FindLog.Elements.size() == 1);
+  BOOST_TEST(FindLog.Elements.count(AddressAt(0x2000)) == 1);
+
+  // Through iteration, only the dereferenced elements are recorded
+  Functions.startWriteTracking();
+  for (Function &F : Functions) {
+    if (F.Entry() == AddressAt(0x2000)) {
+      F.CustomName() = "iterated";
+      break;
+    }
+  }
+  auto IterationLog = Functions.stopWriteTracking();
+  BOOST_TEST(not IterationLog.WholeContent.has_value());
+  BOOST_TEST(IterationLog.Elements.count(AddressAt(0x3000)) == 0);
+
+  // The resulting diff only touches the modified function
+  const model::Binary Before = Model;
+  model::Binary Baseline;
+  startWriteTracking(Model, Baseline);
+  Functions.find(AddressAt(0x3000))->CustomName() = "last";
+  auto Writes = diffWrites(Model, Baseline);
+  BOOST_TEST(Writes.Changes.size() == 1);
+  BOOST_TEST(toString(Writes) == toString(diff(Before, Model)));
+}
+
+BOOST_AUTO_TEST_CASE(HashByPathShouldOnlyDependOnThePathItself) {
+  model::Binary Model;
+  const auto Address = MetaAddress::fromPC(llvm::Triple::ArchType::x86_64,
+                                           0x1000);
+  Model.Segments().insert(Segment(Address, 1000));
+
+  auto SegmentsPath = *stringAsPath<model::Binary>("/Segments");
+  auto NamePath = *stringAsPath<model::Binary>("/Segments/0x1000:Code_x86_64-"
+                                               "1000/CustomName");
+  auto MissingPath = *stringAsPath<model::Binary>("/Segments/0x2000:Code_"
+                                                  "x86_64-1000");
+  auto SegmentsHash = hashByPath(Model, SegmentsPath);
+  auto NameHash = hashByPath(Model, NamePath);
+  BOOST_TEST(SegmentsHash.has_value());
+  BOOST_TEST(NameHash.has_value());
+  BOOST_TEST(not hashByPath(Model, MissingPath).has_value());
+
+  // Changing a field of an element does not affect the container
+  Model.Segments().at(Segment::Key(Address, 1000)).CustomName() = "text";
+  BOOST_TEST((hashByPath(Model, SegmentsPath) == SegmentsHash));
+  BOOST_TEST((hashByPath(Model, NamePath) != NameHash));
+
+  // Adding an element does
+  const auto Other = MetaAddress::fromPC(llvm::Triple::ArchType::x86_64,
+                                         0x2000);
+  Model.Segments().insert(Segment(Other, 1000));
+  BOOST_TEST((hashByPath(Model, SegmentsPath) != SegmentsHash));
+  BOOST_TEST(hashByPath(Model, MissingPath).has_value());
+}
+
+static model::Binary randomSegments(unsigned Count, unsigned Seed) {
+  model::Binary Model;
+  Model.Architecture() = model::Architecture::x86_64;
+
+  // Mostly disjoint segments, with a few overlapping ones
+  std::mt19937_64 Generator(Seed);
+  uint64_t Address = 0x400000;
+  uint64_t Offset = 0;
+  for (unsigned I = 0; I < Count; ++I) {
+    uint64_t Size = 1 + Generator() % 0x3000;
+    uint64_t Start = Address;
+    if (Generator() % 8 == 0 and Address > 0x1000)
+      Start -= Generator() % 0x1000;
+    else
+      Address += Size + Generator() % 0x100;
+
+    model::Segment NewSegment({ MetaAddress::fromGeneric(llvm::Triple::x86_64,
+                                                         Start),
+                                Size });
+    NewSegment.StartOffset() = Offset;
+    NewSegment.FileSize() = Generator() % (Size + 1);
+    NewSegment.IsWriteable() = Generator() % 2;
+    Offset += NewSegment.FileSize();
+    if (Generator() % 8 == 0 and Offset > 0x100)
+      Offset -= Generator() % 0x100;
+
+    Model.Segments().insert(std::move(NewSegment));
+  }
+
+  return Model;
+}
+
+/// Reference implementation of the segment lookup, scanning all the segments
+static const model::Segment *uniqueSegment(const model::Binary &Model,
+                                           MetaAddress Address,
+                                           uint64_t Size) {
+  const model::Segment *Match = nullptr;
+  for (const model::Segment &Segment : Model.Segments()) {
+    if (Segment.contains(Address, Size)) {
+      if (Match != nullptr)
+        return nullptr;
+      Match = &Segment;
+    }
+  }
+  return Match;
+}
+
+static void checkAgainstLinearScan(const model::Binary &Model,
+                                   const RawBinaryView &View,
+                                   unsigned Seed) {
+  std::mt19937_64 Generator(Seed);
+  const model::Segment &Last = *Model.Segments().rbegin();
+  uint64_t Low = 0x400000 - 0x1000;
+  uint64_t High = Last.endAddress().address() + 0x1000;
+  for (unsigned I = 0; I < 4096; ++I) {
+    auto Address = MetaAddress::fromGeneric(llvm::Triple::x86_64,
+                                            Low + Generator() % (High - Low));
+    uint64_t Size = Generator() % 16;
+
+    const model::Segment *Expected = uniqueSegment(Model, Address, Size);
+    auto Offset = View.addressToOffset(Address, Size);
+    BOOST_TEST(Offset.has_value() == (Expected != nullptr));
+    if (Expected != nullptr and Offset) {
+      uint64_t InSegment = Address.address()
+                           - Expected->StartAddress().address();
+      BOOST_TEST(*Offset == Expected->StartOffset() + InSegment);
+    }
+
+    bool ReadOnly = false;
+    for (const model::Segment &Segment : Model.Segments())
+      if (Segment.contains(Address, Size) and not Segment.IsWriteable())
+        ReadOnly = true;
+    BOOST_TEST(View.isReadOnly(Address, Size) == ReadOnly);
+
+    uint64_t FileOffset = Generator() % (Last.endOffset() + 0x100);
+    const model::Segment *ExpectedByOffset = nullptr;
+    unsigned Matches = 0;
+    for (const model::Segment &Segment : Model.Segments()) {
+      if (Segment.StartOffset() <= FileOffset
+          and FileOffset < Segment.endOffset()) {
+        ExpectedByOffset = &Segment;
+        ++Matches;
+      }
+    }
+
+    MetaAddress Translated = View.offsetToAddress(FileOffset);
+    if (Matches == 1) {
+      uint64_t InSegment = FileOffset - ExpectedByOffset->StartOffset();
+      auto ExpectedAddress = ExpectedByOffset->StartAddress() + InSegment;
+      BOOST_TEST((Translated == ExpectedAddress));
+    } else {
+      BOOST_TEST(Translated.isInvalid());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(RawBinaryViewIndexShouldMatchLinearScan) {
+  // From a handful of ELF program headers up to large PE images
+  for (unsigned Count : { 1, 4, 16, 300, 1500 }) {
+    model::Binary Model = randomSegments(Count, Count);
+    RawBinaryView View(Model, llvm::ArrayRef<uint8_t>());
+    checkAgainstLinearScan(Model, View, Count + 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(RawBinaryViewShouldHandleSegmentsAddedLater) {
+  model::Binary Model;
+  Model.Architecture() = model::Architecture::x86_64;
+  RawBinaryView View(Model, llvm::ArrayRef<uint8_t>());
+
+  model::Binary Populated = randomSegments(64, 64);
+  Model.Segments() = Populated.Segments();
+  checkAgainstLinearScan(Model, View, 65);
+}
+
+BOOST_AUTO_TEST_CASE(RawBinaryViewShouldHandleSegmentsEditedInPlace) {
+  model::Binary Model = randomSegments(64, 64);
+  RawBinaryView View(Model, llvm::ArrayRef<uint8_t>());
+
+  // Shrinking the file range of a segment cannot be detected by the view, but
+  // the stale candidates must not be returned
+  unsigned Index = 0;
+  for (model::Segment &Segment : Model.Segments())
+    if (Index++ % 2 == 0)
+      Segment.FileSize() /= 2;
+  checkAgainstLinearScan(Model, View, 66);
+
+  // Arbitrary changes require an explicit reindex
+  Index = 0;
+  for (model::Segment &Segment : Model.Segments())
+    if (Index++ % 3 == 0)
+      Segment.StartOffset() += 0x800;
+  View.reindex();
+  checkAgainstLinearScan(Model, View, 67);
+}
@@ -18,6 +18,7 @@
 #include "llvm/InitializePasses.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/LEB128.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -31,6 +32,7 @@
 #include "revng/Pipeline/Contract.h"
 #include "revng/Pipeline/Errors.h"
 #include "revng/Pipeline/GenericLLVMPipe.h"
+#include "revng/Pipeline/InvalidationMetadata.h"
 #include "revng/Pipeline/Invokable.h"
 #include "revng/Pipeline/Kind.h"
 #include "revng/Pipeline/LLVMContainer.h"
@@ -40,6 +42,8 @@
 #include "revng/Pipeline/Runner.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/TemporaryLLVMOption.h"
+#include "revng/Support/YAMLTraits.h"
 
 #define BOOST_TEST_MODULE Pipeline
 bool init_unit_test();
@@ -776,6 +780,71 @@ BOOST_AUTO_TEST_CASE(LLVMPurePipe) {
   BOOST_TEST(F != nullptr);
 }
 
+struct FunctionMarkerPass : public llvm::ModulePass {
+  static char ID;
+  FunctionMarkerPass() : llvm::ModulePass(ID) {}
+
+  bool runOnModule(llvm::Module &M) override {
+    for (llvm::Function &F : M)
+      if (not F.isDeclaration())
+        F.addFnAttr("marked");
+    return true;
+  }
+};
+char FunctionMarkerPass::ID = '_';
+
+struct LLVMPassFunctionMarker {
+  static constexpr auto Name = "function-marker";
+  static constexpr bool IsFunctionLocal = true;
+
+  std::vector<ContractGroup> getContract() const {
+    return { ContractGroup(FunctionKind) };
+  }
+
+  void registerPasses(llvm::legacy::PassManager &Manager) {
+    Manager.add(new FunctionMarkerPass());
+  }
+};
+
+BOOST_AUTO_TEST_CASE(LLVMShardedPipe) {
+  llvm::LLVMContext C;
+
+  Context Ctx;
+  Runner Pipeline(Ctx);
+  Pipeline.addContainerFactory(CName,
+                               ContainerFactory::fromGlobal<LLVMContainer>(&Ctx,
+                                                                           &C));
+
+  const std::string Name = "first-step";
+  Pipeline.emplaceStep("", Name, "");
+  Pipeline.emplaceStep(Name,
+                       "end",
+                       "",
+                       LLVMContainer::wrapLLVMPasses(CName,
+                                                     LLVMPassFunctionMarker()));
+
+  auto &C1 = Pipeline[Name].containers().getOrCreate<LLVMContainer>(CName);
+  makeF(C1.getModule(), "f1");
+  makeF(C1.getModule(), "f2");
+
+  ContainerToTargetsMap Targets;
+  Targets.add(CName, Target({ "f1" }, FunctionKind));
+  Targets.add(CName, Target({ "f2" }, FunctionKind));
+
+  {
+    TemporaryLLVMOption<unsigned> Threads("llvm-pipe-threads", 2);
+    auto Error = Pipeline.run("end", Targets);
+    BOOST_TEST(!Error);
+  }
+
+  const auto &Final = Pipeline["end"].containers().get<LLVMContainer>(CName);
+  for (llvm::StringRef FName : { "f1", "f2" }) {
+    const auto *F = Final.getModule().getFunction(FName);
+    BOOST_TEST(F != nullptr);
+    BOOST_TEST(F->hasFnAttribute("marked"));
+  }
+}
+
 BOOST_AUTO_TEST_CASE(SingleElementPipelineForwardFinedGrained) {
   Context Ctx;
   Runner Pipeline(Ctx);
@@ -1150,6 +1219,102 @@ public:
 
 static ExampleContainerInpsector Example;
 
+BOOST_AUTO_TEST_CASE(TargetsListBatchInsert) {
+  TargetsList List;
+  List.push_back(Target("f3", FunctionKind));
+
+  {
+    auto Inserter = List.batch_insert();
+    Inserter.emplace("f2", FunctionKind);
+    Inserter.emplace("f1", FunctionKind);
+    Inserter.emplace("f3", FunctionKind);
+    Inserter.emplace(RootKind);
+  }
+
+  BOOST_TEST(List.size() == 4U);
+  BOOST_TEST(std::is_sorted(List.begin(), List.end()));
+  BOOST_TEST(List.contains(Target("f1", FunctionKind)));
+  BOOST_TEST(List.contains(Target("f2", FunctionKind)));
+  BOOST_TEST(List.contains(Target("f3", FunctionKind)));
+  BOOST_TEST(List.contains(Target(RootKind)));
+
+  TargetsList Other = TargetsList::List{ Target("f4", FunctionKind),
+                                         Target("f1", FunctionKind) };
+  List.merge(Other);
+  BOOST_TEST(List.size() == 5U);
+  BOOST_TEST(std::is_sorted(List.begin(), List.end()));
+  BOOST_TEST(List.intersect(Other) == Other);
+}
+
+BOOST_AUTO_TEST_CASE(TargetsInternerAndBimap) {
+  TargetsInterner Interner;
+  TargetInContainer F1(Target("f1", FunctionKind), CName);
+  TargetInContainer F2(Target("f2", FunctionKind), CName);
+
+  auto F1ID = Interner.intern(F1);
+  auto F2ID = Interner.intern(F2);
+  BOOST_TEST(F1ID != F2ID);
+  BOOST_TEST(Interner.intern(F1) == F1ID);
+  BOOST_TEST(Interner.get(F2ID) == F2);
+  BOOST_TEST(Interner.size() == 2U);
+
+  TupleTreePath Path;
+  Path.push_back(size_t(0));
+
+  PathTargetBimap Bimap;
+  Bimap.insert(F1ID, Path);
+  Bimap.insert(F2ID, Path);
+  BOOST_TEST(Bimap.contains(F1ID));
+  BOOST_TEST(Bimap.find(Path)->second.size() == 2U);
+
+  Bimap.remove(Interner, TargetsList({ F1.getTarget() }), CName);
+  BOOST_TEST(not Bimap.contains(F1ID));
+  BOOST_TEST(Bimap.contains(F2ID));
+  BOOST_TEST(Bimap.find(Path)->second.size() == 1U);
+}
+
+BOOST_AUTO_TEST_CASE(TargetsInternerCompaction) {
+  TargetsInterner Interner;
+  TargetInContainer F1(Target("f1", FunctionKind), CName);
+  TargetInContainer F2(Target("f2", FunctionKind), CName);
+  TargetInContainer F3(Target("f3", FunctionKind), CName);
+  auto ID1 = Interner.intern(F1);
+  auto ID2 = Interner.intern(F2);
+  auto ID3 = Interner.intern(F3);
+  BOOST_TEST(Interner.intern(F2) == ID2);
+  BOOST_TEST(Interner.size() == 3U);
+
+  PathTargetBimap Bimap;
+  TupleTreePath Path;
+  Path.push_back(size_t(0));
+  Bimap.insert(ID1, Path);
+  Bimap.insert(ID3, Path);
+
+  // Only the targets still referenced by the bimap survive
+  llvm::BitVector Live(Interner.size());
+  Bimap.collectTargets(Live);
+  auto NewIDs = Interner.compact(Live);
+  Bimap.remapTargets(NewIDs);
+
+  BOOST_TEST(Interner.size() == 2U);
+  BOOST_TEST(NewIDs[ID2] == TargetsInterner::Dropped);
+  BOOST_TEST(not Interner.lookup(F2).has_value());
+  BOOST_TEST(Interner.get(NewIDs[ID1]) == F1);
+  BOOST_TEST(Interner.get(NewIDs[ID3]) == F3);
+  BOOST_TEST(*Interner.lookup(F3) == NewIDs[ID3]);
+  BOOST_TEST(Bimap.contains(NewIDs[ID1]));
+  BOOST_TEST(Bimap.contains(NewIDs[ID3]));
+  BOOST_TEST(Bimap.find(Path)->second.size() == 2U);
+
+  // Interning again after the compaction does not reuse live identifiers
+  BOOST_TEST(Interner.intern(F2) == 2U);
+
+  // Copies have their own index
+  TargetsInterner Copy = Interner;
+  BOOST_TEST(*Copy.lookup(F1) == NewIDs[ID1]);
+  BOOST_TEST(&Copy.get(NewIDs[ID1]) != &Interner.get(NewIDs[ID1]));
+}
+
 BOOST_AUTO_TEST_CASE(EnumerableContainersTest) {
   Context Ctx;
   EnumerableContainerExample Example(Ctx, "dont-care");
@@ -1350,4 +1515,130 @@ BOOST_AUTO_TEST_CASE(PipeOptions) {
     BOOST_FAIL("unreachable");
 }
 
+static InvalidationMetadataVector makeInvalidationMetadata() {
+  InvalidationMetadataVector Result;
+
+  NamedPathTargetBimapVector &Model = Result.emplace_back();
+  Model.GlobalName = "model.yml";
+  auto &WithHashes = Model.Map.Data.emplace_back();
+  WithHashes.Target = { "/root-kind", "first-pipe" };
+  WithHashes.ReadPaths = { "/Functions/0x1000:Code_x86_64/Name",
+                           "/Architecture" };
+  WithHashes.Hashes = { 0xDEADBEEFCAFEBABE, 0 };
+  auto &WithoutHashes = Model.Map.Data.emplace_back();
+  WithoutHashes.Target = { "/function-kind/f1", "second-pipe" };
+  WithoutHashes.ReadPaths = { "/Architecture" };
+
+  NamedPathTargetBimapVector &Other = Result.emplace_back();
+  Other.GlobalName = "other.yml";
+  auto &NoPaths = Other.Map.Data.emplace_back();
+  NoPaths.Target = { "/root-kind", "first-pipe" };
+
+  Result.emplace_back().GlobalName = "empty.yml";
+
+  return Result;
+}
+
+static std::string writeBinary(const InvalidationMetadataVector &ToStore) {
+  std::string Buffer;
+  {
+    llvm::raw_string_ostream OS(Buffer);
+    binary_metadata::write(OS, ToStore);
+  }
+  return Buffer;
+}
+
+static bool isMalformed(llvm::StringRef Buffer) {
+  auto MaybeParsed = binary_metadata::read(Buffer);
+  if (MaybeParsed)
+    return false;
+  llvm::consumeError(MaybeParsed.takeError());
+  return true;
+}
+
+BOOST_AUTO_TEST_CASE(InvalidationMetadataBinaryRoundTrip) {
+  InvalidationMetadataVector Original = makeInvalidationMetadata();
+  std::string Expected = serializeToString(Original);
+
+  // The YAML path is the reference
+  auto FromYAML = deserialize<InvalidationMetadataVector>(Expected);
+  revng_check(FromYAML);
+  BOOST_TEST(serializeToString(*FromYAML) == Expected);
+
+  std::string Binary = writeBinary(Original);
+  BOOST_TEST(binary_metadata::isBinary(Binary));
+  BOOST_TEST(not binary_metadata::isBinary(Expected));
+
+  auto FromBinary = binary_metadata::read(Binary);
+  revng_check(FromBinary);
+  BOOST_TEST(serializeToString(*FromBinary) == Expected);
+
+  // Writing what has been read back produces the very same file
+  BOOST_TEST(writeBinary(*FromBinary) == Binary);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidationMetadataBinaryEmpty) {
+  InvalidationMetadataVector Empty;
+  std::string Binary = writeBinary(Empty);
+  BOOST_TEST(binary_metadata::isBinary(Binary));
+
+  auto Parsed = binary_metadata::read(Binary);
+  revng_check(Parsed);
+  BOOST_TEST(Parsed->empty());
+}
+
+BOOST_AUTO_TEST_CASE(InvalidationMetadataBinaryTruncatedOrCorrupt) {
+  std::string Binary = writeBinary(makeInvalidationMetadata());
+
+  // Every proper prefix of the file must be rejected
+  for (size_t Size = 0; Size < Binary.size(); ++Size)
+    BOOST_TEST(isMalformed(llvm::StringRef(Binary).take_front(Size)));
+
+  // Trailing garbage
+  BOOST_TEST(isMalformed(Binary + "x"));
+
+  auto Header = [](uint64_t Version) {
+    std::string Result = "RVNGINVM";
+    llvm::raw_string_ostream OS(Result);
+    llvm::encodeULEB128(Version, OS);
+    return Result;
+  };
+  auto ULEB = [](uint64_t Value) {
+    std::string Result;
+    llvm::raw_string_ostream OS(Result);
+    llvm::encodeULEB128(Value, OS);
+    return Result;
+  };
+
+  // A count larger than the rest of the file must not be trusted
+  BOOST_TEST(isMalformed(Header(1) + ULEB(uint64_t(1) << 40)));
+
+  // A global name referring to a string that is not in the table
+  BOOST_TEST(isMalformed(Header(1) + ULEB(0) + ULEB(1) + ULEB(0) + ULEB(0)));
+
+  // A string longer than the rest of the file
+  BOOST_TEST(isMalformed(Header(1) + ULEB(1) + ULEB(100) + "abc"));
+
+  // An unterminated ULEB128
+  BOOST_TEST(isMalformed(Header(1) + "\xFF\xFF"));
+}
+
+BOOST_AUTO_TEST_CASE(InvalidationMetadataBinaryWrongHeader) {
+  std::string Binary = writeBinary(makeInvalidationMetadata());
+
+  std::string WrongMagic = Binary;
+  WrongMagic[0] = 'X';
+  BOOST_TEST(not binary_metadata::isBinary(WrongMagic));
+  BOOST_TEST(isMalformed(WrongMagic));
+
+  // The version immediately follows the magic and fits in a single byte
+  std::string WrongVersion = Binary;
+  WrongVersion[8] = 2;
+  BOOST_TEST(binary_metadata::isBinary(WrongVersion));
+  auto MaybeParsed = binary_metadata::read(WrongVersion);
+  revng_check(not MaybeParsed);
+  std::string Message = llvm::toString(MaybeParsed.takeError());
+  BOOST_TEST(llvm::StringRef(Message).contains("version 2"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -138,12 +138,12 @@ BOOST_AUTO_TEST_CASE(LivenessTest) {
   };
 
   auto RunOnSingleNode =
-    [&RunAnalysis](rua::Block::OperationsVector &&Operations) -> BitVector {
+    [&RunAnalysis](rua::Block::OperationsVector &&Operations) -> RegisterSet {
     auto Graph = createSingleNode(std::move(Operations));
     return RunAnalysis(Graph.Function, Graph.Entry)[Graph.Entry].OutValue;
   };
 
-  BitVector Result;
+  RegisterSet Result;
 
   // Only read a register
   Result = RunOnSingleNode({
@@ -182,7 +182,7 @@ BOOST_AUTO_TEST_CASE(LivenessTest) {
     [&RunAnalysis](rua::Block::OperationsVector &&Header,
                    rua::Block::OperationsVector &&Left,
                    rua::Block::OperationsVector &&Right,
-                   rua::Block::OperationsVector &&Footer) -> BitVector {
+                   rua::Block::OperationsVector &&Footer) -> RegisterSet {
     auto Graph = createDiamond(std::move(Header),
                                std::move(Left),
                                std::move(Right),
@@ -228,7 +228,7 @@ BOOST_AUTO_TEST_CASE(LivenessTest) {
     [&RunAnalysis](rua::Block::OperationsVector &&Header,
                    rua::Block::OperationsVector &&LoopHeader,
                    rua::Block::OperationsVector &&LoopBody,
-                   rua::Block::OperationsVector &&Footer) -> BitVector {
+                   rua::Block::OperationsVector &&Footer) -> RegisterSet {
     auto Graph = createLoop(std::move(Header),
                             std::move(LoopHeader),
                             std::move(LoopBody),
@@ -253,7 +253,7 @@ BOOST_AUTO_TEST_CASE(LivenessTest) {
   auto RunOnNoReturn =
     [&RunAnalysis](rua::Block::OperationsVector &&Header,
                    rua::Block::OperationsVector &&NoReturn,
-                   rua::Block::OperationsVector &&Exit) -> BitVector {
+                   rua::Block::OperationsVector &&Exit) -> RegisterSet {
     auto Graph = createNoReturn(std::move(Header),
                                 std::move(NoReturn),
                                 std::move(Exit));
@@ -0,0 +1,135 @@
+/// \file StringMap.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#define BOOST_TEST_MODULE StringMap
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+#include "revng/Pipes/Kinds.h"
+#include "revng/Pipes/StringMap.h"
+#include "revng/Storage/Path.h"
+#include "revng/Support/MetaAddress.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace revng::pipes;
+
+inline constexpr char TestMapName[] = "test-map";
+inline constexpr char TestMapMIMEType[] = "text/plain";
+inline constexpr char TestMapExtension[] = ".txt";
+using TestStringMap = FunctionStringMap<&kinds::FunctionAssemblyInternal,
+                                        TestMapName,
+                                        TestMapMIMEType,
+                                        TestMapExtension>;
+
+static MetaAddress addressAt(uint64_t Address) {
+  return MetaAddress::fromPC(llvm::Triple::ArchType::x86_64, Address);
+}
+
+/// Data that does not compress well, so that the archive is large enough to be
+/// mapped in memory rather than read
+static std::string makeEntry(char Seed) {
+  std::string Result;
+  uint32_t State = Seed;
+  for (size_t I = 0; I < 64 * 1024; ++I) {
+    State = State * 1103515245 + 12345;
+    Result.push_back(static_cast<char>(State >> 16));
+  }
+  return Result;
+}
+
+struct TemporaryDirectory {
+  llvm::SmallString<128> Path;
+
+  TemporaryDirectory() {
+    auto EC = llvm::sys::fs::createUniqueDirectory("revng-string-map", Path);
+    revng_check(not EC);
+  }
+
+  ~TemporaryDirectory() { llvm::sys::fs::remove_directories(Path); }
+
+  std::string file(llvm::StringRef Name) const {
+    llvm::SmallString<128> Result = Path;
+    llvm::sys::path::append(Result, Name);
+    return Result.str().str();
+  }
+};
+
+static void checkStoreOverLazilyLoaded(const revng::FilePath &Path) {
+  const std::string First = makeEntry(1);
+  const std::string Second = makeEntry(2);
+
+  {
+    TestStringMap Map("map");
+    Map[addressAt(0x1000)] = First;
+    Map[addressAt(0x2000)] = Second;
+    llvm::cantFail(Map.store(Path));
+  }
+
+  // Only the first entry is inflated, the second one is still read from the
+  // archive when storing
+  TestStringMap Lazy("map");
+  llvm::cantFail(Lazy.load(Path));
+  Lazy[addressAt(0x1000)] = "changed";
+  llvm::cantFail(Lazy.store(Path));
+
+  TestStringMap Reloaded("map");
+  llvm::cantFail(Reloaded.load(Path));
+  BOOST_TEST(Reloaded.at(addressAt(0x1000)) == "changed");
+  BOOST_TEST(Reloaded.at(addressAt(0x2000)) == Second);
+
+  // The archive Lazy has been loaded from is still intact
+  BOOST_TEST(Lazy.at(addressAt(0x2000)) == Second);
+}
+
+BOOST_AUTO_TEST_CASE(StoreOverTheLazilyLoadedArchive) {
+  TemporaryDirectory Directory;
+  auto Path = revng::FilePath::fromLocalStorage(Directory.file("map.tar.gz"));
+  checkStoreOverLazilyLoaded(Path);
+}
+
+BOOST_AUTO_TEST_CASE(StoreOverTheLazilyLoadedArchiveThroughASymlink) {
+  TemporaryDirectory Directory;
+  std::string Target = Directory.file("map.tar.gz");
+  std::string Link = Directory.file("link.tar.gz");
+  {
+    TestStringMap Empty("map");
+    llvm::cantFail(Empty.store(revng::FilePath::fromLocalStorage(Target)));
+  }
+  revng_check(not llvm::sys::fs::create_link(Target, Link));
+
+  auto LinkPath = revng::FilePath::fromLocalStorage(Link);
+  checkStoreOverLazilyLoaded(LinkPath);
+
+  // The symlink has been preserved
+  llvm::sys::fs::file_status Status;
+  revng_check(not llvm::sys::fs::status(Link, Status, /* Follow */ false));
+  BOOST_TEST(llvm::sys::fs::is_symlink_file(Status));
+}
+
+BOOST_AUTO_TEST_CASE(StaleIndexesShouldBeIgnored) {
+  TemporaryDirectory Directory;
+  auto Path = revng::FilePath::fromLocalStorage(Directory.file("map.tar.gz"));
+  auto OtherPath = revng::FilePath::fromLocalStorage(Directory.file("other"));
+
+  // Two archives of the same size, the first one with the index of the other
+  TestStringMap Map("map");
+  Map[addressAt(0x1000)] = "first";
+  llvm::cantFail(Map.store(Path));
+  Map[addressAt(0x1000)] = "other";
+  llvm::cantFail(Map.store(OtherPath));
+  auto OtherIndexPath = OtherPath.addExtension("idx");
+  llvm::cantFail(OtherIndexPath.copyTo(Path.addExtension("idx")));
+
+  TestStringMap Reloaded("map");
+  llvm::cantFail(Reloaded.load(Path));
+  BOOST_TEST(Reloaded.at(addressAt(0x1000)) == "first");
+}